@@ -11,6 +11,61 @@ namespace hr {
 EX int fontscale = 100;
 
 #if HDR
+/** \brief all the copies of each cell drawn in the current frame
+ *
+ *  The copies live in a single contiguous arena, linked per cell; like cell_index, clearing is O(1).
+ */
+struct drawn_copies_index {
+  struct copy { shiftmatrix V; int next; };
+  struct ends { int first, last; };
+  cell_index<ends> where;
+  vector<copy> copies;
+
+  struct copy_iterator {
+    const vector<copy> *v; int i;
+    const shiftmatrix& operator * () const { return (*v)[i].V; }
+    copy_iterator& operator ++ () { i = (*v)[i].next; return *this; }
+    bool operator != (const copy_iterator& x) const { return i != x.i; }
+    };
+
+  /** the copies of a single cell; emplace_back adds a new one */
+  struct cell_copies {
+    drawn_copies_index *dc; cell *c;
+    copy_iterator begin() const { int i = dc->where.index_of(c); return copy_iterator{&dc->copies, i < 0 ? -1 : dc->where.at_index(i).second.first}; }
+    copy_iterator end() const { return copy_iterator{&dc->copies, -1}; }
+    void emplace_back(const shiftmatrix& V) { dc->add(c, V); }
+    int size() const { int q = 0; for(auto it = begin(); it != end(); ++it) q++; return q; }
+    };
+
+  struct iterator {
+    drawn_copies_index *dc; int i;
+    pair<cell*, cell_copies> operator * () const { cell *c = dc->where.at_index(i).first; return make_pair(c, cell_copies{dc, c}); }
+    iterator& operator ++ () { i++; return *this; }
+    bool operator != (const iterator& x) const { return i != x.i; }
+    };
+
+  iterator begin() { return iterator{this, 0}; }
+  iterator end() { return iterator{this, where.size()}; }
+
+  cell_copies operator [] (cell *c) { return cell_copies{this, c}; }
+  int count(cell *c) const { return where.count(c); }
+  int size() const { return where.size(); }
+
+  void add(cell *c, const shiftmatrix& V) {
+    int id = isize(copies);
+    copies.push_back(copy{V, -1});
+    int i = where.index_of(c);
+    if(i < 0) where[c] = ends{id, id};
+    else {
+      auto& e = where.at_index(i).second;
+      copies[e.last].next = id;
+      e.last = id;
+      }
+    }
+
+  void clear() { where.clear(); copies.clear(); }
+  };
+
 /** configuration of the current view */
 struct display_data {
   /** The cell which is currently in the center. */
@@ -22,7 +77,7 @@ struct display_data {
   /** The view relative to the player character. */
   shiftmatrix player_matrix;
   /** On-screen coordinates for all the visible cells. */
-  unordered_map<cell*, shiftmatrix> cellmatrices, old_cellmatrices;
+  cell_index<shiftmatrix> cellmatrices, old_cellmatrices;
   /** Position of the current map view, relative to the screen (0 to 1). */
   ld xmin, ymin, xmax, ymax;
   /** Position of the current map view, in pixels. */
@@ -50,7 +105,7 @@ struct display_data {
   /** Which copy of the player cell? */
   transmatrix which_copy;
   /** On-screen coordinates for all the visible cells. */
-  unordered_map<cell*, vector<shiftmatrix>> all_drawn_copies;
+  drawn_copies_index all_drawn_copies;
   };
 
 #define View (::hr::current_display->view_matrix)
@@ -138,6 +193,11 @@ EX string fontpath = ISWEB ? "sans-serif" : HYPERPATH "DejaVuSans-Bold.ttf";
 
 void loadfont(int siz) {
   if(!font[siz]) {
+    /* in the offscreen mode, TTF is initialized only once a text is drawn */
+    if(!TTF_WasInit() && TTF_Init() != 0) {
+      printf("Failed to initialize TTF.\n");
+      exit(2);
+      }
     font[siz] = TTF_OpenFont(fontpath.c_str(), siz);
     // Destination set by ./configure (in the GitHub repository)
     #ifdef FONTDESTDIR
@@ -1115,6 +1175,9 @@ EX void setvideomode() {
 
 EX bool noGUI = false;
 
+/** no window either, but screenshots and animations are rendered to software surfaces (-offscreen) */
+EX bool offscreen = false;
+
 EX void initgraph() {
 
   DEBBI(DF_INIT | DF_GRAPH, ("initgraph"));
@@ -1128,6 +1191,8 @@ EX void initgraph() {
   restartGraph();
   
   if(noGUI) {
+    /* there is no GL context, so only the SDL surfaces of the renderbuffers can be used */
+    if(offscreen) vid.usingGL = false;
 #if CAP_COMMANDLINE
     arg::read(2);
 #endif
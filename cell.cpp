@@ -18,6 +18,10 @@ struct hrmap {
   virtual cell *gamestart() { return getOrigin()->c7; }
   virtual ~hrmap() { };
   virtual vector<cell*>& allcells();
+  /** allcells of bounded maps, computed again only when cells have been created or destroyed */
+  vector<cell*> allcells_cache;
+  cell *allcells_start = nullptr;
+  int allcells_cellcount = -1, allcells_deletions = -1;
   virtual void verify() { }
   virtual void link_alt(const cellwalker& hs) { }
   virtual void generateAlts(heptagon *h, int levs = default_levs(), bool link_cdata = true);
@@ -60,6 +64,126 @@ struct hrmap {
   virtual double spacedist(cell *c, int i) { return hdist0(tC0(adj(c, i))); }
   };
 
+/** \brief a map from cells (or other pointers) to values, cheap to clear
+ *
+ *  Entries are kept in insertion order in a chunked arena, so references stay valid until clear(),
+ *  and are found in O(1) via an open addressing table. clear() only bumps the epoch, so nothing
+ *  is freed or reallocated between frames. The interface mimics std::map.
+ */
+template<class T, class Key = cell*> struct cell_index {
+  struct entry { Key first; T second; };
+  enum { CHUNK = 256 };
+
+  cell_index() : qty(0), epoch(1), hash_shift(64) {}
+
+  int size() const { return qty; }
+  bool empty() const { return qty == 0; }
+
+  entry& at_index(int i) { return chunks[i / CHUNK][i % CHUNK]; }
+  const entry& at_index(int i) const { return chunks[i / CHUNK][i % CHUNK]; }
+
+  template<class E, class C> struct iter {
+    C *ci; int i;
+    E& operator * () const { return ci->at_index(i); }
+    E* operator -> () const { return &ci->at_index(i); }
+    iter& operator ++ () { i++; return *this; }
+    iter operator ++ (int) { iter res = *this; i++; return res; }
+    bool operator == (const iter& x) const { return i == x.i; }
+    bool operator != (const iter& x) const { return i != x.i; }
+    };
+  typedef iter<entry, cell_index> iterator;
+  typedef iter<const entry, const cell_index> const_iterator;
+
+  iterator begin() { return iterator{this, 0}; }
+  iterator end() { return iterator{this, qty}; }
+  const_iterator begin() const { return const_iterator{this, 0}; }
+  const_iterator end() const { return const_iterator{this, qty}; }
+
+  /** index of c in the arena, or -1 */
+  int index_of(Key c) const {
+    if(slots.empty()) return -1;
+    for(int s = hash(c);; s = (s+1) & (isize(slots)-1)) {
+      auto& sl = slots[s];
+      if(sl.epoch != epoch) return -1;
+      if(at_index(sl.id).first == c) return sl.id;
+      }
+    }
+
+  iterator find(Key c) { int i = index_of(c); return iterator{this, i < 0 ? qty : i}; }
+  const_iterator find(Key c) const { int i = index_of(c); return const_iterator{this, i < 0 ? qty : i}; }
+  int count(Key c) const { return index_of(c) >= 0; }
+
+  T& operator [] (Key c) {
+    int i = index_of(c);
+    if(i >= 0) return at_index(i).second;
+    return insert(c).second;
+    }
+
+  T& at(Key c) {
+    int i = index_of(c);
+    if(i < 0) throw std::out_of_range("cell_index::at");
+    return at_index(i).second;
+    }
+
+  void clear() {
+    qty = 0;
+    if(!++epoch) {
+      for(auto& sl: slots) sl.epoch = 0;
+      epoch = 1;
+      }
+    }
+
+  private:
+  struct slot { unsigned epoch; int id; };
+  vector<vector<entry>> chunks;
+  vector<slot> slots;
+  int qty;
+  unsigned epoch;
+  int hash_shift;
+
+  int hash(Key c) const {
+    return int((uint64_t(uintptr_t(c)) * 0x9E3779B97F4A7C15ull) >> hash_shift);
+    }
+
+  void put(int id) {
+    int s = hash(at_index(id).first);
+    while(slots[s].epoch == epoch) s = (s+1) & (isize(slots)-1);
+    slots[s].epoch = epoch; slots[s].id = id;
+    }
+
+  entry& insert(Key c) {
+    if(2 * (qty+1) > isize(slots)) {
+      slots.assign(max(64, 2 * isize(slots)), slot{0, 0});
+      hash_shift = 64;
+      for(int s = isize(slots); s > 1; s >>= 1) hash_shift--;
+      for(int i=0; i<qty; i++) put(i);
+      }
+    if(qty == CHUNK * isize(chunks)) chunks.emplace_back(CHUNK);
+    auto& e = at_index(qty);
+    e.first = c; e.second = T();
+    put(qty++);
+    return e;
+    }
+  };
+
+/** \brief caches used by hrmap_standard::relative_matrix in hyperbolic tilings, see geometry2.cpp */
+struct relative_matrix_cache {
+  /** skew-binary jump pointer along move(0); depth counts the move(0) steps to the origin, 
+   *  T and Ti are the products of adj and iadj on the way to jump */
+  struct ancestor { heptagon *jump; int depth; transmatrix T, Ti; };
+  cell_index<ancestor, heptagon*> ancestors;
+  /** direct-mapped memo of results */
+  struct memo { heptagon *h2, *h1; transmatrix T; };
+  vector<memo> memos;
+  /** scratch space for get_ancestor */
+  vector<heptagon*> chain;
+  /** value of heptagon_deletions when the caches were last valid */
+  int deletions;
+  /** the largest difference of distance between adjacent heptagons */
+  int max_gap;
+  relative_matrix_cache() : deletions(-1), max_gap(1) {}
+  };
+
 /** hrmaps which are based on regular non-Euclidean 2D tilings, possibly quotient  
  *  Operators can be applied to these maps. 
  *  Liskov substitution warning: maps which produce both tiling like above and 3D tilings
@@ -74,6 +198,12 @@ struct hrmap_standard : hrmap {
   transmatrix adj(heptagon *h, int d) override;
   ld spin_angle(cell *c, int d) override;
   double spacedist(cell *c, int i) override;
+  relative_matrix_cache rm_cache;
+  relative_matrix_cache::ancestor* get_ancestor(heptagon *h);
+  bool lift(heptagon*& h, int target, transmatrix *gm, transmatrix *where);
+  #if CAP_CRYSTAL
+  transmatrix relative_matrix_crystal(heptagon *h2, heptagon *h1);
+  #endif
   };
 
 void clearfrom(heptagon*);
@@ -112,12 +242,21 @@ transmatrix hrmap::spin_from(cell *c, int d, ld bonus) {
 
 transmatrix hrmap::adj(heptagon *h, int i) { return relative_matrix(h->cmove(i), h, C0); }
 
+/** the number of times hrmap::allcells had to list all the cells of a bounded map */
+EX int allcells_searches;
+
 vector<cell*>& hrmap::allcells() { 
   static vector<cell*> default_allcells;
   if(bounded && !(cgflags & qHUGE_BOUNDED) && !(hybri && hybrid::csteps == 0)) {
-    celllister cl(gamestart(), 1000000, 1000000, NULL);
-    default_allcells = cl.lst;
-    return default_allcells;
+    cell *start = gamestart();
+    if(start != allcells_start || cellcount != allcells_cellcount || cell_deletions != allcells_deletions) {
+      allcells_searches++;
+      celllister cl(start, 1000000, 1000000, NULL);
+      allcells_cache = cl.lst;
+      /* the listing may have created cells */
+      allcells_start = start; allcells_cellcount = cellcount; allcells_deletions = cell_deletions;
+      }
+    return allcells_cache;
     }
   if(isize(dcal) <= 1) {
     extern cellwalker cwt;
@@ -137,7 +276,11 @@ EX int dirdiff(int dd, int t) {
 
 EX int cellcount = 0;
 
+/** incremented whenever a cell is freed, so that caches keyed by cell* know to reset */
+EX int cell_deletions;
+
 EX void destroy_cell(cell *c) {
+  cell_deletions++;
   tailored_delete(c);
   cellcount--;
   }
@@ -376,13 +519,18 @@ void unlink_cdata(heptagon *h) {
     }
   }
 
+/** incremented whenever heptagons may have been freed, so that caches keyed by heptagon* know to reset */
+EX int heptagon_deletions;
+
 EX void clear_heptagon(heptagon *at) {
+  heptagon_deletions++;
   clearHexes(at);
   tailored_delete(at);
   }
 
 EX void clearfrom(heptagon *at) {
   if(!at) return;
+  heptagon_deletions++;
   queue<heptagon*> q;
   unlink_cdata(at);
   q.push(at);
@@ -1207,7 +1355,7 @@ EX void clearCellMemory() {
   dists_computed.clear();
   keep_distances_from.clear(); perma_distances = 0;
   pd_from = NULL;
-  gp::gp_adj.clear();
+  gp::clear_adj();
   }
 
 auto cellhooks = addHook(hooks_clearmemory, 500, clearCellMemory);
@@ -1342,4 +1490,29 @@ EX int valence() {
   return S3;
   }
 
+#if CAP_COMMANDLINE
+int read_cell_args() {
+  using namespace arg;
+  if(0) ;
+  else if(argis("-allcells-bench")) {
+    /* time N calls of allcells, against listing the cells every time */
+    PHASEFROM(3); shift(); int n = argi();
+    start_game();
+    if(!bounded) { println(hlog, "-allcells-bench: the map is not bounded"); return 0; }
+    int searches = allcells_searches;
+    int t0 = SDL_GetTicks();
+    long long total = 0;
+    for(int i=0; i<n; i++) total += isize(currentmap->allcells());
+    int t1 = SDL_GetTicks();
+    for(int i=0; i<n; i++) total -= isize(celllister(currentmap->gamestart(), 1000000, 1000000, NULL).lst);
+    int t2 = SDL_GetTicks();
+    println(hlog, n, " calls of allcells (", isize(currentmap->allcells()), " cells): ", t1-t0, " ms, ", allcells_searches - searches, " searches (", allcells_searches, " in total); listing every time: ", t2-t1, " ms", total ? " (counts differ)" : "");
+    }
+  else return 1;
+  return 0;
+  }
+
+auto ah_cell = addHook(hooks_args, 0, read_cell_args);
+#endif
+
 }
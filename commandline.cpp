@@ -51,6 +51,10 @@ EX eMonster readMonster(const string& ss) {
 EX }
 
 EX void initializeCLI() {
+  #if CAP_SHOT && CAP_PNG && !ISWINDOWS
+  /* the standard output is going to be the frame stream, so even this should not go there */
+  for(auto& a: arg::argument) if(a == "-shot-stdout") shot::stream_to_stdout();
+  #endif
   printf("HyperRogue by Zeno Rogue <zeno@attnam.com>, version " VER "\n");
 
 #if !NOLICENSE
@@ -153,6 +157,7 @@ int arg::readCommon() {
   if(argis("-s")) { PHASE(1); shift(); scorefile = argcs(); }
   else if(argis("-rsrc")) { PHASE(1); shift(); rsrcdir = args(); }
   else if(argis("-nogui")) { PHASE(1); noGUI = true; }
+  else if(argis("-offscreen")) { PHASE(1); noGUI = true; offscreen = true; }
 #ifndef EMSCRIPTEN
 #if CAP_SDL
   else if(argis("-font")) { PHASE(1); shift(); fontpath = args(); }
@@ -254,6 +259,7 @@ int arg::readCommon() {
     }
   else if(argis("-exit")) {
     PHASE(3); printf("Success.\n");
+    profile_info();
     exit(0);
     }
 
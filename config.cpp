@@ -304,6 +304,7 @@ EX void initConfig() {
   // basic graphics
   
   addsaver(vid.usingGL, "usingGL", true);
+  addsaver(swrast::enabled, "software rasterizer", true);
   addsaver(vid.antialias, "antialias", AA_NOGL | AA_FONT | (ISWEB ? AA_MULTI : AA_LINES) | AA_LINEWIDTH | AA_VERSION);
   addsaver(vid.linewidth, "linewidth", 1);
   addsaver(precise_width, "precisewidth", .5);
@@ -322,6 +323,7 @@ EX void initConfig() {
   addsaver(vid.graphglyph, "graphical items/kills", 1);
   addsaver(vid.particles, "extra effects", 1);
   addsaver(vid.framelimit, "frame limit", 75);
+  addsaver(frame_reuse, "frame reuse", 0);
   addsaver(vid.xres, "xres");
   addsaver(vid.yres, "yres");
   addsaver(vid.fsize, "font size");
@@ -365,6 +367,9 @@ EX void initConfig() {
   
   addsaver(memory_saving_mode, "memory_saving_mode", (ISMOBILE || ISPANDORA || ISWEB) ? 1 : 0);
   addsaver(reserve_limit, "memory_reserve", 128);
+  #if CAP_THREAD
+  addsaver(workers::threads_wanted, "worker threads", 0);
+  #endif
   addsaver(show_memory_warning, "show_memory_warning");
 
   auto& rconf = vid.rug_config;
@@ -545,6 +550,9 @@ EX void initConfig() {
   addsaver(shot::gamma, "shotgamma");
   addsaver(shot::caption, "shotcaption");
   addsaver(shot::fade, "shotfade");
+  #if CAP_PNG
+  addsaver(shot::tile_size, "shottile", 0);
+  #endif
   #endif
 
 #if CAP_TEXTURE  
@@ -1094,6 +1102,10 @@ EX void showGraphConfig() {
     mouseovers = XLAT("Reduce the framerate limit to conserve CPU energy");
   #endif
 
+  dialog::addSelItem(XLAT("reuse idle frames"), frame_reuse == 0 ? XLAT("never") : frame_reuse == 1 ? XLAT("in menus") : XLAT("always"), 'r');
+  if(getcstat == 'r')
+    mouseovers = XLAT("time-based animations of the map stop while a frame is reused (reused: %1, drawn: %2)", its(frames_reused), its(frames_rebuilt));
+
 #if !ISIOS && !ISWEB
   dialog::addBoolItem(XLAT("fullscreen mode"), (vid.full), 'f');
 #endif
@@ -1209,6 +1221,9 @@ EX void showGraphConfig() {
       dialog::bound_low(5);
       }
   #endif
+
+    else if(xuni == 'r')
+      frame_reuse = (frame_reuse + 1) % 3;
       
     else if(xuni =='p') 
       vid.backeffects = !vid.backeffects;
@@ -1283,6 +1298,15 @@ EX void configureOther() {
   dialog::addItem(XLAT("memory configuration"), 'y');
   dialog::add_action_push(show_memory_menu);
 
+#if CAP_THREAD
+  dialog::addSelItem(XLAT("worker threads"), workers::threads_wanted ? its(workers::threads_wanted) : XLAT("auto") + " (" + its(workers::get_threads()) + ")", 't');
+  dialog::add_action([] {
+    dialog::editNumber(workers::threads_wanted, 0, 64, 1, 0, XLAT("worker threads"),
+      XLAT("The number of threads used for heavy computations, such as generating field quotients or simulations. 0 = one per core."));
+    dialog::bound_low(0);
+    });
+#endif
+
   // dialog::addBoolItem_action(XLAT("forget faraway cells"), memory_saving_mode, 'y');
   
 #if CAP_AUDIO
@@ -2446,6 +2470,9 @@ EX int read_config_args() {
     PHASEFROM(2);
     nofps = true;
     }
+  else if(argis("-frame-reuse")) {
+    PHASEFROM(2); shift(); frame_reuse = argi();
+    }
   else if(argis("-nohud")) {
     PHASEFROM(2);
     nohud = true;
@@ -2502,6 +2529,18 @@ EX int read_config_args() {
   else if(argis("-msm")) {
     PHASEFROM(2); memory_saving_mode = true;
     }
+  else if(argis("-threads")) {
+    PHASEFROM(2); shift(); workers::threads_wanted = argi();
+    }
+  else if(argis("-cache-dir")) {
+    shift(); disk_cache::dir = args();
+    }
+  else if(argis("-nocache")) {
+    disk_cache::enabled = false;
+    }
+  else if(argis("-cache-stats")) {
+    PHASE(3); disk_cache::report();
+    }
   else if(argis("-mrsv")) {
     PHASEFROM(2); shift(); reserve_limit = argi(); apply_memory_reserve();
     }
@@ -782,6 +782,7 @@ EX void mainloopiter() {
   
 EX void handle_event(SDL_Event& ev) {
   bool normal = cmode & sm::NORMAL;
+  input_events++;
     DEBB(DF_GRAPH, ("got event type #%d\n", ev.type));
     int sym = 0;
     int uni = 0;
@@ -1011,6 +1012,14 @@ EX void handle_event(SDL_Event& ev) {
       nofps = !nofps;
       sym = 0;
       }
+
+    #if CAP_PROFILING
+    if(sym == SDLK_F6 && anyshiftclick) {
+      profiler::overlay = !profiler::overlay;
+      if(profiler::overlay) profiler::on = true;
+      sym = 0;
+      }
+    #endif
       
     handlekey(sym, uni);
     }
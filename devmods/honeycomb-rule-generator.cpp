@@ -28,6 +28,10 @@ This algorithm works as follows:
   For non-tree directions, we construct a path going through nodes with smaller values of FV --
   this guarantees termination of the algorithm in amortized time O(1).
 
+  The expensive part, finding the paths for the side rules, only reads the map, so it is
+  done on the worker pool (use -threads to control the number of threads). Progress and
+  throughput are reported about once a second.
+
 */
 
 #include "zlib.h"
@@ -35,10 +39,10 @@ This algorithm works as follows:
 
 namespace hr {
 
-map<string, map<string,int> > rules;
-
-/** \brief S7 -- for efficiency this is a fixed constant */
+/** \brief S7 -- for efficiency this is a fixed constant; can be also given with -DXS7=... */
+#ifndef XS7
 #define XS7 20
+#endif
 
 /** \brief distance from the center */
 #define FV master->fiftyval
@@ -105,22 +109,21 @@ string find_path(cell *x, cell *y) {
   if(x == y) return "";
 
   if(geometry == gSpace353) {
-    static int max_steps = -1;
+    /* called from multiple threads */
+    static std::atomic<int> max_steps(-1);
     
     for(int steps=0; steps<5; steps++) {
       string f = find_path_side(x, y, steps);
       if(f != "?") {
-        if(steps > max_steps) {
-          println(hlog, "found a sidepath with ", max_steps = steps, " steps");
-          }
+        int m = max_steps;
+        while(steps > m && !max_steps.compare_exchange_weak(m, steps)) ;
+        if(steps > m) println(hlog, "found a sidepath with ", steps, " steps");
         return f;
         }
       }
     
-    if(max_steps < 10) {
-      max_steps = 10;
+    if(max_steps.exchange(10) < 10)
       println(hlog, "failed to find_path_side");
-      }
     }
   
   for(int steps=0;; steps++) {
@@ -186,30 +189,112 @@ void fix_dist(cell *a, cell *b) {
     }  
   }
 
-/** \brief compute ext_nei_rules_t for the given cell, and make it into a string form; also do fix_dist */
+/** \brief a state signature: get_id (4 bytes) followed by FV(c')-FV(c) for the original cells c' of ext_nei_rules_t */
+typedef vector<signed char> signature;
+
+/** \brief compute ext_nei_rules_t for the given cell, and write its signature to res; also do fix_dist */
 
-string generate_ext_nei(cell *c) {
+void generate_ext_nei(cell *c, signature& res) {
   int fv = get_id(c);
   auto& e = ext_nei_rules[fv];
   if(e.from.empty()) construct_rules(c, e);
-  vector<cell*> ext_nei = {c};
+  static vector<cell*> ext_nei;
+  ext_nei.clear();
+  ext_nei.push_back(c);
   for(int i=1; i<isize(e.from); i++) {
     cell *last = ext_nei[e.from[i]];
     cell *next = last->cmove(e.dir[i]);
     fix_dist(last, next);
     ext_nei.push_back(next);
     }
-  string res;
-  for(int i=0; i<isize(e.from); i++) if(e.original[i]) res += char('L' + ext_nei[i]->FV - c->FV);
-  return its(fv) + ":" + res;
+  res.clear();
+  for(int k=0; k<4; k++) res.push_back(fv >> (8*k));
+  for(int i=0; i<isize(e.from); i++) if(e.original[i]) res.push_back(ext_nei[i]->FV - c->FV);
   }
 
+/** \brief signatures interned in an open addressing hash table, each mapped to a state ID */
+struct state_table {
+  /** all the signatures, one after another: the k-th is pool[start[k] .. start[k+1]) */
+  vector<signed char> pool;
+  vector<int> start = {0};
+  /** the state ID of the k-th signature */
+  vector<int> state;
+  /** indices of signatures, -1 = empty */
+  vector<int> slots;
+
+  static unsigned hash(const signed char *p, int n) {
+    unsigned h = 2166136261u;
+    for(int i=0; i<n; i++) h = (h ^ (unsigned char) p[i]) * 16777619u;
+    return h;
+    }
+
+  static unsigned hash(const signature& s) { return hash(s.data(), isize(s)); }
+
+  bool equal(int k, const signature& s) const {
+    return start[k+1] - start[k] == isize(s) && std::equal(s.begin(), s.end(), pool.begin() + start[k]);
+    }
+
+  /** the index of s, or -1 */
+  int find(const signature& s) const {
+    if(slots.empty()) return -1;
+    for(unsigned i = hash(s);; i++) {
+      int k = slots[i & (isize(slots)-1)];
+      if(k == -1) return -1;
+      if(equal(k, s)) return k;
+      }
+    }
+
+  /** add s (which must not be present yet) as the given state */
+  void insert(const signature& s, int st) {
+    if(2 * isize(state) + 2 > isize(slots)) {
+      slots.assign(max(isize(slots) * 2, 1024), -1);
+      for(int k=0; k<isize(state); k++) place(k, hash(&pool[start[k]], start[k+1] - start[k]));
+      }
+    int k = isize(state);
+    pool.insert(pool.end(), s.begin(), s.end());
+    start.push_back(isize(pool));
+    state.push_back(st);
+    place(k, hash(s));
+    }
+
+  void place(int k, unsigned h) {
+    for(unsigned i = h;; i++) {
+      int& sl = slots[i & (isize(slots)-1)];
+      if(sl == -1) { sl = k; return; }
+      }
+    }
+
+  /** the state of s, or -1 */
+  int operator [] (const signature& s) const {
+    int k = find(s);
+    return k == -1 ? -1 : state[k];
+    }
+
+  int size() const { return isize(state); }
+  };
+
 /** cells become 'candidates' before their generate_ext_nei is checked in order to let them become states */
-set<cell*> candidates;
+cell_index<char> candidates;
 vector<cell*> candidates_list;
 
-/** the state ID for a given string returned by generate_ext_nei */
-map<string, int> id_of;
+/** the state ID for a given signature returned by generate_ext_nei */
+state_table id_of;
+
+/** \brief the state of c (computing its ext_nei); -1 if not known */
+int state_of(cell *c) {
+  static signature s;
+  generate_ext_nei(c, s);
+  return id_of[s];
+  }
+
+/** \brief report the progress of a phase, at most once per second */
+void progress(const char *phase, int done, int total, int t0, int& last) {
+  int t = SDL_GetTicks();
+  if(t < last + 1000 && done < total) return;
+  last = t;
+  println(hlog, phase, ": ", done, "/", total, ", ", int(done * 1000. / max(t - t0, 1)), " per second, ", t - t0, " ms");
+  fflush(stdout);
+  }
 
 /** cell representing the given state ID */
 vector<cell*> rep_of;
@@ -225,7 +310,7 @@ vector<array<string, XS7> > side_rules;
 
 void add_candidate(cell *c) {
   if(candidates.count(c)) return;
-  candidates.insert(c);
+  candidates[c];
   candidates_list.push_back(c);
   }
 
@@ -262,28 +347,29 @@ void test_canonical(string fname) {
   
   /** generate candidate_list using a BFS-like algorithm, starting from c0 */
   
+  int t0 = SDL_GetTicks(), last = t0;
+  signature sig;
   for(int i=0; i<isize(candidates_list); i++) {
     cell *c = candidates_list[i];
-    string s = generate_ext_nei(c);
-    if(!id_of.count(s)) {
-      // println(hlog, "found candidate for: ", s);
-      id_of[s] = number_states++;
+    generate_ext_nei(c, sig);
+    if(id_of.find(sig) == -1) {
+      id_of.insert(sig, number_states++);
       rep_of.push_back(c);
       for(int i=0; i<S7; i++) add_candidate(c->cmove(i));
       }
+    progress("candidates", i+1, isize(candidates_list), t0, last);
     }
   
   child_rules.resize(number_states, empty);
   
-  println(hlog, "found ", its(number_states), " states");
+  println(hlog, "found ", its(number_states), " states, ", isize(candidates_list), " candidates");
   
   /** generate child_rules */
 
   for(int i=0; i<number_states; i++) {
     cell *c = rep_of[i];
 
-    string st = generate_ext_nei(c);
-    if(!id_of.count(st) || id_of[st] != i) {
+    if(state_of(c) != i) {
       println(hlog, "error: ext_nei changed");
       }
 
@@ -294,11 +380,11 @@ void test_canonical(string fname) {
         cell *c2 = c1->move(b);
         if(c2->FV != c->FV) continue;
         if(c2 == c) {
-          string st = generate_ext_nei(c1);
-          if(!id_of.count(st)) {
+          int st = state_of(c1);
+          if(st == -1) {
             println(hlog, "error: new state generated while generating child_rules");
             }
-          child_rules[i][a] = id_of[st];
+          child_rules[i][a] = st;
           }
         break;
         }
@@ -317,23 +403,27 @@ void test_canonical(string fname) {
     
     int lqids = 0;
     
+    vector<array<int, XS7>> v(number_states);
+    vector<int> order(number_states);
     for(int a=0; a<100; a++) {
-      set<array<int, XS7>> found;
-      vector<array<int, XS7>> v(number_states);
-      map<array<int, XS7>, int> ids;
-      for(int i=0; i<number_states; i++) {
-        array<int, XS7> res;
-        for(int d=0; d<XS7; d++) res[d] = (child_rules[i][d] != -1) ? ih[child_rules[i][d]] : -1;
-        v[i] = res;
-        found.insert(res);
-        }
+      workers::parallel_for(0, number_states, 4096, [&] (int from, int to) {
+        for(int i=from; i<to; i++)
+        for(int d=0; d<XS7; d++) v[i][d] = (child_rules[i][d] != -1) ? ih[child_rules[i][d]] : -1;
+        });
+      /* number the distinct arrays in lexicographic order */
+      for(int i=0; i<number_states; i++) order[i] = i;
+      sort(order.begin(), order.end(), [&] (int i, int j) { return v[i] < v[j]; });
       int qids = 0;
-      for(auto hash: found) ids[hash] = qids++;
+      vector<int> new_ih(number_states);
+      for(int k=0; k<number_states; k++) {
+        if(k && v[order[k]] != v[order[k-1]]) qids++;
+        new_ih[order[k]] = qids;
+        }
+      if(number_states) qids++;
       println(hlog, "minimization step: ", qids, " states");
       if(qids == lqids) break;
       lqids = qids;
-      for(int i=0; i<number_states; i++)
-        ih[i] = ids[v[i]];
+      ih = new_ih;
       }
     
     println(hlog, "reduced states to = ", lqids);
@@ -348,7 +438,7 @@ void test_canonical(string fname) {
       }
     child_rules = new_child_rules;
     number_states = lqids;
-    for(auto& p: id_of) p.second = ih[p.second];
+    for(auto& st: id_of.state) st = ih[st];
     println(hlog, "rehashed");
     fflush(stdout);
     }
@@ -359,14 +449,27 @@ void test_canonical(string fname) {
   /* generate side rules */
   side_rules.resize(number_states);
 
-  for(int i=0; i<isize(candidates_list); i++) {
+  /* computing the states may extend the map, so do it first */
+  int NC = isize(candidates_list);
+  vector<int> cand_state(NC);
+  for(int i=0; i<NC; i++) {
+    cand_state[i] = state_of(candidates_list[i]);
+    if(cand_state[i] == -1) println(hlog, "error: MISSING");
+    }
+
+  /* the paths are found in parallel; the map is only read from now on */
+  vector<array<string, XS7>> solutions(NC);
+  vector<char> mismatch(NC, 0);
+  std::atomic<int> done(0);
+  t0 = SDL_GetTicks(), last = t0;
+  std::mutex progress_lock;
+
+  workers::parallel_for(0, NC, 16, [&] (int from, int to) { for(int i=from; i<to; i++) {
     cell *c = candidates_list[i];
-    string s = generate_ext_nei(c);
-    if(!id_of.count(s)) println(hlog, "error: MISSING");
-    int id = id_of[s];
+    int id = cand_state[i];
     
     cell *cpar = nullptr;
-    int a0;
+    int a0 = 0;
 
     for(int a=0; a<S7; a++) {
       cell *c1 = c->move(a);
@@ -377,7 +480,6 @@ void test_canonical(string fname) {
     for(int a=0; a<S7; a++) {
       cell *c1 = c->move(a);
       if(!c1) continue;
-      bool is_child = false;
       cell* c2 = nullptr;
       int dir = 0;
       
@@ -391,10 +493,52 @@ void test_canonical(string fname) {
           }
         }
 
-      is_child = (c2 == c);
+      bool is_child = (c2 == c);
       bool was_child = child_rules[id][a] >= 0;
 
-      if(is_child ^ was_child) {
+      if(is_child ^ was_child) { mismatch[i] = true; break; }
+      if(is_child) continue;
+      
+      if(c1->FV < c->FV)
+        solutions[i][a] = dis(a0, 'A') + find_path(cpar, c1);
+      else if(c1->FV == c->FV)
+        solutions[i][a] = dis(a0, 'A') + find_path(cpar, c2) + dis(dir);
+      else 
+        solutions[i][a] = find_path(c, c2) + dis(dir);
+      }
+    int d = ++done;
+    if(progress_lock.try_lock()) {
+      progress("side rules", d, NC, t0, last);
+      progress_lock.unlock();
+      }
+    }});
+  println(hlog, "side rules computed in ", SDL_GetTicks() - t0, " ms");
+
+  /* merge the results in the original order */
+  for(int i=0; i<NC; i++) {
+    cell *c = candidates_list[i];
+    int id = cand_state[i];
+    
+    for(int a=0; a<S7; a++) {
+      cell *c1 = c->move(a);
+      if(!c1) continue;
+      cell* c2 = nullptr;
+      int dir = 0;
+      
+      if(c1->FV >= c->FV) {
+        for(int b=0; b<S7; b++) {
+          c2 = c1->move(b);
+          if(!c2) continue;
+          if(c2->FV >= c1->FV) continue;
+          dir = c1->c.spin(b);
+          break;
+          }
+        }
+
+      bool is_child = (c2 == c);
+      bool was_child = child_rules[id][a] >= 0;
+
+      if(mismatch[i] && (is_child ^ was_child)) {
         println(hlog, "id=", id, " a=", a);
         println(hlog, "is_child = ", is_child);
         println(hlog, "was_child = ", was_child);
@@ -418,14 +562,7 @@ void test_canonical(string fname) {
       
       if(is_child) continue;
       
-      string solu;
-      
-      if(c1->FV < c->FV)
-        solu = dis(a0, 'A') + find_path(cpar, c1);
-      else if(c1->FV == c->FV)
-        solu = dis(a0, 'A') + find_path(cpar, c2) + dis(dir);
-      else 
-        solu = find_path(c, c2) + dis(dir);
+      string& solu = solutions[i][a];
       
       auto& sr = side_rules[id][a];
       
@@ -455,7 +592,7 @@ void test_canonical(string fname) {
   hwrite_fpattern(ss, fp);
 
   vector<int> root(qc, 0);
-  for(int i=0; i<qc; i++) root[i] = id_of[generate_ext_nei(c0[i])];
+  for(int i=0; i<qc; i++) root[i] = state_of(c0[i]);
   println(hlog, "root = ", root);
 
   hwrite(ss, root);
@@ -486,6 +623,11 @@ auto fqhook =
   else if(argis("-gen-rule")) {
     shift(); test_canonical(args());
     }
+  else if(argis("-rule-save-raw")) {
+    /* convert the currently loaded rules to the uncompressed, mmap-able format */
+    start_game();
+    shift(); reg3::rule_save_raw(args());
+    }
   else return 1;
   return 0;
   });
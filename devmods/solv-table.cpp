@@ -32,13 +32,11 @@ transmatrix parabolic1(ld u);
 
 namespace sn {
 
-template<class T> void parallelize(int threads, int Nmin, int Nmax, T action) {
-  std::vector<std::thread> v;
-  for(int k=0; k<threads; k++)
-    v.emplace_back([&,k] () { 
-      for(int i=Nmin+k; i < Nmax; i += threads) action(k, i);
-      });
-  for(std::thread& t:v) t.join();
+/* run action(i) for Nmin <= i < Nmax on the worker pool (-threads) */
+template<class T> void parallelize(int Nmin, int Nmax, T action) {
+  workers::parallel_for(Nmin, Nmax, 1, [&] (int a, int b) {
+    for(int i=a; i<b; i++) action(i);
+    });
   }
 
 ld solerror(hyperpoint ok, hyperpoint chk) {
@@ -197,7 +195,7 @@ void build_sols(int PRECX, int PRECY, int PRECZ) {
   auto& tab = sn::get_tabled();
   alloc_table(tab, PRECX, PRECY, PRECZ);
   int last_x = PRECX-1, last_y = PRECY-1, last_z = PRECZ-1;
-  auto act = [&] (int tid, int iz) {
+  auto act = [&] (int iz) {
     if((nih && iz == 0) || iz == PRECZ-1) return;
   
     auto solve_at = [&] (int ix, int iy) {
@@ -267,7 +265,7 @@ void build_sols(int PRECX, int PRECY, int PRECZ) {
       }
     };
 
-  parallelize(PRECZ, 0, PRECZ, act);
+  parallelize(0, PRECZ, act);
   
   fix_boundaries(tab, last_x, last_y, last_z);
   }
@@ -478,7 +476,7 @@ void improve(sn::tabled_inverses& tab) {
   int last_x = PRECX-1, last_y = PRECY-1, last_z = PRECZ-1;
 
   max_iter = 1000;
-  auto act = [&] (int tid, int iz) {
+  auto act = [&] (int iz) {
     if((nih && iz == 0) || iz == PRECZ-1) return;
     for(int iy=0; iy<last_y; iy++)
     for(int ix=0; ix<last_x; ix++) {
@@ -503,7 +501,7 @@ void improve(sn::tabled_inverses& tab) {
     };
   max_iter = 1000000;
   
-  parallelize(PRECZ, 0, PRECZ, act);
+  parallelize(0, PRECZ, act);
   if(deb) exit(7);
 
 
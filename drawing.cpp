@@ -38,6 +38,7 @@ static const int POLY_PRINTABLE = (1<<25);      // these walls are printable
 static const int POLY_FAT = (1<<26);            // fatten this model in WRL export (used for Rug)
 static const int POLY_SHADE_TEXTURE = (1<<27);  // texture has 'z' coordinate for shading
 static const int POLY_ONE_LEVEL = (1<<28);      // only one level of the universal cover in SL(2,R)
+static const int POLY_LINES = (1<<29);          // made of separate LINES (pairs of vertices), not a LINE_STRIP
 
 /** \brief A graphical element that can be drawn. Objects are not drawn immediately but rather queued.
  *
@@ -182,6 +183,7 @@ vector<glvertex> line_vertices;
 
 EX void glflush() {
   DEBBI(DF_GRAPH, ("glflush"));
+  PROFILE_ZONE("glflush");
   #if MINIMIZE_GL_CALLS
   if(isize(triangle_vertices)) {
     // printf("%08X %08X | %d shapes, %d/%d vertices\n", triangle_color, line_color, shapes_merged, isize(triangle_vertices), isize(line_vertices));
@@ -502,6 +504,7 @@ void polylineColor(SDL_Surface *s, int *x, int *y, int polyi, color_t col) {
   }
 
 EX void filledPolygonColorI(SDL_Surface *s, int* px, int *py, int polyi, color_t col) {
+  if(swrast::fill_polygon(s, px, py, polyi, col)) return;
   std::vector<Sint16> spx(px, px + polyi);
   std::vector<Sint16> spy(py, py + polyi);
   filledPolygonColor(s, spx.data(), spy.data(), polyi, col);
@@ -528,30 +531,241 @@ void drawTexturedTriangle(SDL_Surface *s, int *px, int *py, glvertex *tv, color_
   for(int i=1; i<3; i++)
     minx = min(minx, px[i]), maxx = max(maxx, px[i]),
     miny = min(miny, py[i]), maxy = max(maxy, py[i]);
-  for(int mx=minx; mx<maxx; mx++)
-  for(int my=miny; my<maxy; my++) {
-    hyperpoint h = isource * point3(mx, my, 1);
-    if(h[0] >= -1e-7 && h[1] >= -1e-7 && h[2] >= -1e-7) {
-      hyperpoint ht = target * h;
-      int tw = texture::config.data.twidth;
-      int x = int(ht[0] * tw) & (tw-1);
-      int y = int(ht[1] * tw) & (tw-1);
-      color_t c;
-      if(texture::config.data.texture_pixels.size() == 0)
-        c = 0xFFFFFFFF;
-      else
-        c = texture::config.data.texture_pixels[y * tw + x];
-      auto& pix = qpixel(s, mx, my);
-      for(int p=0; p<3; p++) {
-        int alpha = part(c, 3) * part(col, 0);
-        auto& v = part(pix, p);
-        v = ((255*255 - alpha) * 255 * v + alpha * part(col, p+1) * part(c, p) + 255 * 255 * 255/2 + 1) / (255 * 255 * 255);
+  minx = max(minx, 0); maxx = min(maxx, s->w);
+  miny = max(miny, 0); maxy = min(maxy, s->h);
+  if(minx >= maxx || miny >= maxy) return;
+  int tw = texture::config.data.twidth;
+  auto& pixels = texture::config.data.texture_pixels;
+
+  auto rows = [&] (int ya, int yb) {
+    for(int my=ya; my<yb; my++) {
+      /* the pixels inside the triangle form a span; find it with a margin, the exact test is below */
+      ld lo = minx, hi = maxx;
+      for(int k=0; k<3; k++) {
+        ld a = isource[k][0], b = isource[k][1] * my + isource[k][2];
+        if(a > 0) lo = max(lo, (-1e-7 - b) / a - 1);
+        else if(a < 0) hi = min(hi, (-1e-7 - b) / a + 1);
+        }
+      int xa = max<ld>(lo, minx), xb = min<ld>(hi + 1, maxx);
+      for(int mx=xa; mx<xb; mx++) {
+        hyperpoint h = isource * point3(mx, my, 1);
+        if(h[0] >= -1e-7 && h[1] >= -1e-7 && h[2] >= -1e-7) {
+          hyperpoint ht = target * h;
+          int x = int(ht[0] * tw) & (tw-1);
+          int y = int(ht[1] * tw) & (tw-1);
+          color_t c;
+          if(pixels.size() == 0)
+            c = 0xFFFFFFFF;
+          else
+            c = pixels[y * tw + x];
+          auto& pix = qpixel(s, mx, my);
+          for(int p=0; p<3; p++) {
+            int alpha = part(c, 3) * part(col, 0);
+            auto& v = part(pix, p);
+            v = ((255*255 - alpha) * 255 * v + alpha * part(col, p+1) * part(c, p) + 255 * 255 * 255/2 + 1) / (255 * 255 * 255);
+            }
+          }
         }
       }
+    };
+
+  if((maxx - minx) * (maxy - miny) >= swrast::parallel_threshold)
+    workers::parallel_for(miny, maxy, swrast::BAND, rows);
+  else
+    rows(miny, maxy);
+  }
+#endif
+
+/** \brief the internal rasterizer for the non-GL renderer
+ *
+ *  Polygons are filled with the same pixel coverage rules as SDL_gfx's filledPolygonColor
+ *  (even-odd rule, 16.16 fixed point intersections, the bottom row included), so the output
+ *  should not change. The edges are binned into bands of BAND rows, so a row only looks at the
+ *  edges which may cross it, and large polygons are filled band-parallel on the worker threads.
+ */
+EX namespace swrast {
+
+  /** use the internal rasterizer rather than SDL_gfx for filled polygons (32-bit surfaces only) */
+  EX bool enabled = true;
+
+  /** polygons whose bounding box has fewer pixels than this are filled in the calling thread */
+  EX int parallel_threshold = 1<<17;
+
+  #if HDR
+  static constexpr int BAND = 16;
+  #endif
+
+  #if CAP_SDL
+  struct edge {
+    int y1, y2, ylast;
+    long long x1, dx;
+    };
+
+  vector<edge> edges;
+  vector<int> band_start, band_edges;
+
+  /** blend the pixels xa..xb of the row; d + (s-d)*a/256 rounded down equals (d*(256-a) + s*a) >> 8,
+   *  so two channels can be blended in one multiplication, and the loop can be vectorized */
+  void fill_span(Uint32 *row, int xa, int xb, color_t col, Uint32 amask) {
+    Uint32 a = part(col, 0);
+    Uint32 src = (col >> 8) | (a << 24);
+    if(a == 255) {
+      Uint32 full = (src & 0xFFFFFF) | amask;
+      for(int x=xa; x<=xb; x++) row[x] = full;
+      return;
+      }
+    if(a == 0) return;
+    Uint32 na = 256 - a;
+    Uint32 srb = (src & 0xFF00FF) * a, sag = ((src >> 8) & 0xFF00FF) * a;
+    Uint32 keep = 0xFF00 | amask;
+    for(int x=xa; x<=xb; x++) {
+      Uint32 d = row[x];
+      Uint32 rb = (((d & 0xFF00FF) * na + srb) >> 8) & 0xFF00FF;
+      Uint32 ag = (((d >> 8) & 0xFF00FF) * na + sag) & 0xFF00FF00;
+      row[x] = rb | (ag & keep);
+      }
+    }
+
+  /** fill a polygon on s; returns false if the internal rasterizer cannot be used, and SDL_gfx should be used instead */
+  EX bool fill_polygon(SDL_Surface *s, int *px, int *py, int n, color_t col) {
+    if(!enabled || !s || s->format->BytesPerPixel != 4) return false;
+    if(n < 3) return true;
+
+    int miny = py[0], maxy = py[0], minx = px[0], maxx = px[0];
+    for(int i=1; i<n; i++)
+      miny = min(miny, py[i]), maxy = max(maxy, py[i]),
+      minx = min(minx, px[i]), maxx = max(maxx, px[i]);
+
+    int cx0 = s->clip_rect.x, cx1 = s->clip_rect.x + s->clip_rect.w - 1;
+    int ya = max<int>(miny, s->clip_rect.y), yb = min<int>(maxy, s->clip_rect.y + s->clip_rect.h - 1);
+    if(ya > yb || maxx < cx0 || minx > cx1) return true;
+
+    edges.clear();
+    for(int i=0; i<n; i++) {
+      int j = i ? i-1 : n-1;
+      edge e;
+      if(py[j] < py[i]) e.y1 = py[j], e.y2 = py[i], e.x1 = px[j], e.dx = px[i] - px[j];
+      else if(py[j] > py[i]) e.y1 = py[i], e.y2 = py[j], e.x1 = px[i], e.dx = px[j] - px[i];
+      else continue;
+      e.ylast = e.y2 == maxy ? e.y2 : e.y2 - 1;
+      if(e.ylast < ya || e.y1 > yb) continue;
+      e.x1 <<= 16;
+      edges.push_back(e);
+      }
+
+    int bands = (yb - ya) / BAND + 1;
+    band_start.assign(bands + 1, 0);
+    for(auto& e: edges)
+      for(int b = (max(e.y1, ya) - ya) / BAND; b <= (min(e.ylast, yb) - ya) / BAND; b++)
+        band_start[b+1]++;
+    for(int b=0; b<bands; b++) band_start[b+1] += band_start[b];
+    band_edges.resize(band_start[bands]);
+    vector<int> pos(band_start.begin(), band_start.end() - 1);
+    for(int i=0; i<isize(edges); i++) {
+      auto& e = edges[i];
+      for(int b = (max(e.y1, ya) - ya) / BAND; b <= (min(e.ylast, yb) - ya) / BAND; b++)
+        band_edges[pos[b]++] = i;
+      }
+
+    Uint32 amask = s->format->Amask;
+    auto fill_bands = [&] (int b0, int b1) {
+      vector<long long> ints;
+      for(int b=b0; b<b1; b++)
+      for(int y = ya + b * BAND; y <= min(yb, ya + b * BAND + BAND - 1); y++) {
+        ints.clear();
+        for(int k=band_start[b]; k<band_start[b+1]; k++) {
+          auto& e = edges[band_edges[k]];
+          if(y >= e.y1 && y <= e.ylast)
+            ints.push_back(((65536LL * (y - e.y1)) / (e.y2 - e.y1)) * e.dx + e.x1);
+          }
+        sort(ints.begin(), ints.end());
+        Uint32 *row = (Uint32*) ((char*) s->pixels + y * s->pitch);
+        for(int i=0; i+1<isize(ints); i+=2) {
+          long long xa = ints[i] + 1, xb = ints[i+1] - 1;
+          xa = (xa >> 16) + ((xa & 32768) >> 15);
+          xb = (xb >> 16) + ((xb & 32768) >> 15);
+          if(xa > xb) swap(xa, xb);
+          xa = max<long long>(xa, cx0); xb = min<long long>(xb, cx1);
+          if(xa <= xb) fill_span(row, xa, xb, col, amask);
+          }
+        }
+      };
+
+    if((long long) (yb - ya + 1) * (min(maxx, cx1) - max(minx, cx0) + 1) >= parallel_threshold)
+      workers::parallel_for(0, bands, 1, fill_bands);
+    else
+      fill_bands(0, bands);
+    return true;
     }
+  #endif
+
+  #if CAP_SDLGFX
+  /** draw qty random polygons both with SDL_gfx and with the internal rasterizer, and compare the pixels */
+  EX void pixel_diff_test(int qty) {
+    int w = 1920, h = 1080;
+    SDL_Surface *sf[2];
+    for(auto& s1: sf) {
+      s1 = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, 32, 0xFF<<16, 0xFF<<8, 0xFF, 0);
+      for(int y=0; y<h; y++) for(int x=0; x<w; x++) qpixel(s1, x, y) = (x * 255 / w) << 16 | (y * 255 / h) << 8 | 0x40;
+      }
+    std::mt19937 gen(qty);
+    auto rnd = [&] (int a, int b) { return std::uniform_int_distribution<int>(a, b)(gen); };
+    int ticks[2] = {0, 0};
+    vector<int> xs, ys;
+    for(int i=0; i<qty; i++) {
+      /* stars around a center are concave; also triangles, large polygons partially off the
+       * surface and many-vertex polygons, like circles or inverse fills in the game */
+      int kind = rnd(0, 3);
+      int n = kind == 0 ? 3 : kind == 3 ? rnd(200, 2000) : rnd(4, 12);
+      int cx = rnd(-200, w + 200), cy = rnd(-200, h + 200);
+      int r = kind == 2 ? rnd(500, 3000) : rnd(5, 300);
+      xs.resize(n); ys.resize(n);
+      for(int j=0; j<n; j++) {
+        ld alpha = 2 * M_PI * (j + (kind == 3 ? 0 : rnd(0, 99) / 100.)) / n;
+        int rr = kind == 3 ? r : rnd(r/3, r);
+        xs[j] = cx + int(rr * cos(alpha)), ys[j] = cy + int(rr * sin(alpha));
+        }
+      color_t col = (color_t(rnd(0, 0xFFFFFF)) << 8) | (rnd(0, 1) ? 0xFF : rnd(0, 255));
+      for(int k=0; k<2; k++) {
+        dynamicval<bool> de(enabled, k);
+        int t = SDL_GetTicks();
+        filledPolygonColorI(sf[k], &xs[0], &ys[0], n, col);
+        ticks[k] += SDL_GetTicks() - t;
+        }
+      }
+    int diff = 0, maxdiff = 0;
+    for(int y=0; y<h; y++) for(int x=0; x<w; x++) {
+      color_t c0 = qpixel(sf[0], x, y), c1 = qpixel(sf[1], x, y);
+      int d = 0;
+      for(int p=0; p<3; p++) d = max(d, abs(part(c0, p) - part(c1, p)));
+      if(d) diff++;
+      maxdiff = max(maxdiff, d);
+      }
+    println(hlog, qty, " polygons: SDL_gfx ", ticks[0], " ms, internal ", ticks[1], " ms; ", diff, " pixels differ (max channel difference ", maxdiff, ")");
+    for(auto s1: sf) SDL_FreeSurface(s1);
+    }
+  #endif
+
+#if CAP_COMMANDLINE
+int read_args() {
+  using namespace arg;
+  if(argis("-swrast")) {
+    PHASEFROM(2); shift(); enabled = argi();
+    }
+  #if CAP_SDLGFX
+  else if(argis("-swrast-test")) {
+    PHASEFROM(2); shift(); pixel_diff_test(argi());
+    }
+  #endif
+  else return 1;
+  return 0;
   }
+
+auto ah = addHook(hooks_args, 0, read_args);
 #endif
 
+EX }
+
 #if CAP_GL
 
 EX int global_projection;
@@ -581,6 +795,9 @@ void dqi_poly::gldraw() {
       if(color) for(int i=0; i<cnt; i++) triangle_vertices.push_back(v2[0]), triangle_vertices.push_back(v2[i]), triangle_vertices.push_back(v2[i+1]);
       for(int i=1; i<cnt; i++) line_vertices.push_back(v2[i]), line_vertices.push_back(v2[i+1]);
       }
+    else if(flags & POLY_LINES) {
+      for(int i=0; i<cnt; i++) line_vertices.push_back(glhr::pointtogl( V.T * glhr::gltopoint( v[offset+i] ) ));
+      }
     else {
       vector<glvertex> v2(cnt);
       for(int i=0; i<cnt; i++) v2[i] = glhr::pointtogl( V.T * glhr::gltopoint( v[offset+i] ) );
@@ -699,7 +916,7 @@ void dqi_poly::gldraw() {
         }
 
       else
-        glDrawArrays(GL_LINE_STRIP, offset, cnt);
+        glDrawArrays((flags & POLY_LINES) ? GL_LINES : GL_LINE_STRIP, offset, cnt);
       }
     }
 
@@ -1496,6 +1713,25 @@ void dqi_poly::draw() {
     println(hlog);
     }
 
+  if(flags & POLY_LINES) {
+    bool direct = false;
+    #if CAP_GL
+    direct = vid.usingGL && vid.stereo_mode != sODS && !in_s2xe() && !(sphere && (stretch::factor || ray::in_use)) && 
+      (current_display->set_all(global_projection, V.shift), get_shader_flags() & SF_DIRECT);
+    #endif
+    /* only the direct OpenGL path knows about separate lines -- everything else gets them one by one */
+    if(!direct) {
+      dynamicval<int> df(flags, flags & ~POLY_LINES);
+      dynamicval<int> dc(cnt, 2);
+      dynamicval<int> doff(offset, offset);
+      for(int i=0; i+1<dc.backup; i+=2) {
+        offset = doff.backup + i;
+        draw();
+        }
+      return;
+      }
+    }
+
   #if CAP_ODS  
   if(vid.stereo_mode == sODS) {
     ods::draw_ods(this);
@@ -1786,7 +2022,7 @@ void dqi_poly::draw() {
           svg::polygon(polyx+i, polyy+i, 3, col, outline, get_width(this));
         }        
       else
-        svg::polygon(polyx, polyy, polyi, col, outline, get_width(this));
+        svg::polygon(polyx, polyy, polyi, col, outline, get_width(this), l ? nullptr : tab, offset);
       continue;
       }
   #endif
@@ -1998,6 +2234,7 @@ void dqi_line::draw_back() {
   }
 
 EX void sort_drawqueue() {
+  PROFILE_ZONE("sort_drawqueue");
 
   #if MAXMDIM >= 4 && CAP_GL
   if(WDIM == 2 && GDIM == 3 && hyperbolic) make_air();
@@ -2095,6 +2332,7 @@ EX void reverse_transparent_walls() {
 
 EX void draw_main() {
   DEBBI(DF_GRAPH, ("draw_main"));
+  PROFILE_ZONE("draw_main");
   if(sphere && GDIM == 3 && pmodel == mdPerspective && !stretch::in() && !ray::in_use) {
 
     if(ray::in_use && !ray::comparison_mode) {
@@ -2178,6 +2416,7 @@ EX hookset<bool()> hooks_vr_draw_all;
 EX void drawqueue() {
 
   DEBBI(DF_GRAPH, ("drawqueue"));
+  PROFILE_ZONE("drawqueue");
 
   #if CAP_WRL
   if(wrl::in) { wrl::render(); return; }
@@ -2193,8 +2432,6 @@ EX void drawqueue() {
     glClear(GL_STENCIL_BUFFER_BIT);
 #endif
   
-  profile_start(3);
-  
   sort_drawqueue();
 
   DEBB(DF_GRAPH, ("sort walls"));
@@ -2225,7 +2462,6 @@ EX void drawqueue() {
         });
     }
 
-  profile_stop(3);
 
 #if CAP_SDL
   if(current_display->stereo_active() && !vid.usingGL) {
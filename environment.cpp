@@ -199,6 +199,7 @@ struct pathdata {
 
 /** calculate cpdist, 'have' flags, and do general fixings */
 EX void bfs() {
+  PROFILE_ZONE("bfs");
 
   calcTidalPhase(); 
     
@@ -22,11 +22,35 @@ void canonicize(vector<int>& t) {
   }
 
 #if HDR
+/** \brief a table of interned type signatures
+ *
+ *  The signatures are stored in a single flat pool, and found by open addressing,
+ *  so looking up a signature does not allocate anything.
+ */
+struct signature_table {
+  vector<int> pool;
+  vector<int> start;
+  vector<int> value;
+  vector<int> slots;
+
+  int size() { return isize(start); }
+  void clear();
+  int *find(const vector<int>& sig);
+  int& insert(const vector<int>& sig);
+
+  private:
+  static unsigned hash(const int *sig, int len);
+  int& slot_of(const int *sig, int len);
+  void rehash(int n);
+  };
+
 struct expansion_analyzer {
-  vector<int> gettype(cell *c);
   int N;
   vector<cell*> samples;  
-  map<vector<int>, int> codeid;  
+  /** signature to id */
+  signature_table codeid;
+  /** buffer for computing signatures */
+  vector<int> sig;
   vector<vector<int> > children;  
   int rootid, diskid;
   int coefficients_known;
@@ -59,24 +83,69 @@ struct expansion_analyzer {
   };
 #endif
 
-vector<int> expansion_analyzer::gettype(cell *c) {
-  vector<int> res;
+void signature_table::clear() {
+  pool.clear(); start.clear(); value.clear(); slots.clear();
+  }
+
+unsigned signature_table::hash(const int *sig, int len) {
+  unsigned h = 2166136261u;
+  for(int i=0; i<len; i++) h = (h ^ unsigned(sig[i])) * 16777619u;
+  return h;
+  }
+
+int& signature_table::slot_of(const int *sig, int len) {
+  unsigned mask = isize(slots) - 1;
+  for(unsigned p = hash(sig, len) & mask;; p = (p+1) & mask) {
+    int& s = slots[p];
+    if(!s) return s;
+    int st = start[s-1];
+    if(pool[st] == len && equal(sig, sig+len, pool.begin()+st+1)) return s;
+    }
+  }
+
+void signature_table::rehash(int n) {
+  slots.assign(n, 0);
+  for(int id=0; id<size(); id++)
+    slot_of(&pool[start[id]+1], pool[start[id]]) = id+1;
+  }
+
+int *signature_table::find(const vector<int>& sig) {
+  if(slots.empty()) return nullptr;
+  int s = slot_of(sig.data(), isize(sig));
+  return s ? &value[s-1] : nullptr;
+  }
+
+int& signature_table::insert(const vector<int>& sig) {
+  if(2 * (size() + 1) > isize(slots)) rehash(max(16, 2 * isize(slots)));
+  int& s = slot_of(sig.data(), isize(sig));
+  if(!s) {
+    s = size() + 1;
+    start.push_back(isize(pool));
+    pool.push_back(isize(sig));
+    for(int i: sig) pool.push_back(i);
+    value.push_back(0);
+    }
+  return value[s-1];
+  }
+
+/** compute the type signature of c into res, reusing its memory */
+template<class T> void make_signature(vector<int>& res, cell *c, const T& distfun) {
+  res.clear();
   res.push_back(subtype(c) * 4 + 2);
-  int d = celldist(c);
+  int d = distfun(c);
   for(int i=0; i<c->type; i++) {
     cell *c1 = c->cmove(i);
     int bonus = 0;
     if(bt::in()) bonus += 16 * (celldistAlt(c1) - celldistAlt(c));
-    res.push_back(bonus + subtype(c1) * 4 + celldist(c1) - d);
+    res.push_back(bonus + subtype(c1) * 4 + distfun(c1) - d);
     }
   canonicize(res);
-  return res;
   }
 
 int expansion_analyzer::sample_id(cell *c) {
-  auto t = gettype(c);
-  if(codeid.count(t)) return codeid[t];
-  auto &cit = codeid[t];
+  make_signature(sig, c, celldist);
+  if(auto p = codeid.find(sig)) return *p;
+  int& cit = codeid.insert(sig);
   cit = isize(samples);
   samples.push_back(c);
   return cit;
@@ -179,7 +248,7 @@ void expansion_analyzer::reduce_grouping() {
     for(int j: children[groupsample[i]])
       newchildren[i].push_back(grouping[j]);
   children = move(newchildren);
-  for(auto& p: codeid) p.second = grouping[p.second];
+  for(int& v: codeid.value) v = grouping[v];
   N = nogroups;
   rootid = grouping[rootid];
   diskid = grouping[diskid];
@@ -199,6 +268,7 @@ bignum& expansion_analyzer::get_descendants(int level) {
 
 bignum& expansion_analyzer::get_descendants(int level, int type) {
   auto& pd = descendants;
+  if(level < isize(pd) && isize(pd[level]) == N) return pd[level][type];
   size_upto(pd, level+1);
   for(int d=0; d<=level; d++)
   for(int i=size_upto(pd[d], N); i<N; i++)
@@ -340,20 +410,10 @@ void expansion_analyzer::reset() {
 
 EX int type_in(expansion_analyzer& ea, cell *c, const cellfunction& f) {
   if(!ea.N) ea.preliminary_grouping(), ea.reduce_grouping();
-  vector<int> res;
-  res.push_back(subtype(c) * 4 + 2);
-  int d = f(c);
-  for(int i=0; i<c->type; i++) {
-    cell *c1 = c->cmove(i);
-    int bonus = 0;
-    if(bt::in()) bonus += 16 * (celldistAlt(c1) - celldistAlt(c));
-    res.push_back(bonus + subtype(c1) * 4 + f(c1) - d);
-    }
-  
-  canonicize(res);
-  if(ea.codeid.count(res)) return ea.codeid[res];
+  make_signature(ea.sig, c, f);
+  if(auto p = ea.codeid.find(ea.sig)) return *p;
   int ret = ea.N++;
-  ea.codeid[res] = ret;
+  ea.codeid.insert(ea.sig) = ret;
   
   ea.children.emplace_back();
   ea.children[ret] = get_children_codes(c, f, [&ea, &f] (cell *c1) { return type_in(ea, c1, f); });
@@ -362,7 +422,8 @@ EX int type_in(expansion_analyzer& ea, cell *c, const cellfunction& f) {
   }
 
 int type_in_quick(expansion_analyzer& ea, cell *c, const cellfunction& f) {
-  vector<int> res;
+  auto& res = ea.sig;
+  res.clear();
   res.push_back(subtype(c) * 4 + 2);
   int d = f(c);
   for(int i=0; i<c->type; i++) {
@@ -373,7 +434,7 @@ int type_in_quick(expansion_analyzer& ea, cell *c, const cellfunction& f) {
     }
   
   canonicize(res);
-  if(ea.codeid.count(res)) return ea.codeid[res];
+  if(auto p = ea.codeid.find(res)) return *p;
   return -1;
   }
 
@@ -895,6 +956,29 @@ int expansion_readArgs() {
     viewdists = false;
     }
 
+  /* benchmark the analyzer on the current tiling, e.g.:
+     -symbol 4,6,8 -expansion-bench 100
+     -tes tessellations/sample/floret.tes -expansion-bench 100 */
+  else if(argis("-expansion-bench")) {
+    PHASEFROM(2);
+    start_game();
+    shift(); int radius = argi();
+    expansion.reset();
+    int t0 = SDL_GetTicks();
+    expansion.preliminary_grouping();
+    int t1 = SDL_GetTicks();
+    int N0 = expansion.N;
+    expansion.reduce_grouping();
+    int t2 = SDL_GetTicks();
+    expansion.get_descendants(radius);
+    int t3 = SDL_GetTicks();
+    expansion.find_coefficients();
+    int t4 = SDL_GetTicks();
+    println(hlog, full_geometry_name(), ": types ", N0, " -> ", expansion.N, 
+      ", grouping ", t1-t0, " ms, reducing ", t2-t1, " ms, descendants up to ", radius, ": ", t3-t2, 
+      " ms, coefficients ", t4-t3, " ms", expansion.coefficients_known == 2 ? "" : " (not found)");
+    }
+
   else return 1;
   return 0;
   }
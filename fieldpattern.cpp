@@ -245,6 +245,8 @@ struct fpattern {
   int cs, sn, ch, sh;
   
   int solve();
+
+  int solve_search();
   
   void build();
   
@@ -320,14 +322,16 @@ struct fpattern {
 #if CAP_THREAD && MAXMDIM >= 4
 struct discovery {
   fpattern experiment;
-  std::shared_ptr<std::thread> discoverer;
+  /** the search runs as a background task on the worker pool */
+  bool started;
+  workers::task_group discoverer;
   std::mutex lock;
   std::condition_variable cv;
   bool is_suspended;
   bool stop_it;
   
   map<unsigned, tuple<int, int, matrix, matrix, matrix, int> > hashes_found;
-  discovery() : experiment(0) { is_suspended = false; stop_it = false; experiment.dis = this; experiment.Prime = experiment.Field = experiment.wsquare = 0; }
+  discovery() : experiment(0) { started = false; is_suspended = false; stop_it = false; experiment.dis = this; experiment.Prime = experiment.Field = experiment.wsquare = 0; }
   
   void activate();
   void suspend();
@@ -567,7 +571,43 @@ void fpattern::set_field(int p, int sq) {
   for(int a=0; a<MWDIM; a++) for(int b=0; b<MWDIM; b++) Id[a][b] = a==b?1:0;
   }
 
+#if MAXMDIM >= 4
+/** solve3 searches the isometry group, which may take minutes, so its results are kept in the disk cache */
+string solve3_cache_key(int Prime, unsigned force_hash) {
+  shstream ss;
+  print(ss, ginf[geometry].tiling_name, " ", int(ginf[geometry].g.kind), " ", S7, " ", S3, " p", Prime, " h", force_hash, " ", limitsq, " ", limitv);
+  return ss.s;
+  }
+#endif
+
 int fpattern::solve() {
+  #if MAXMDIM >= 4
+  bool cacheable = WDIM == 3 && isprime(Prime);
+  #if CAP_THREAD
+  if(dis) cacheable = false;
+  #endif
+  if(cacheable) {
+    string key = solve3_cache_key(Prime, force_hash);
+    int res = 0;
+    if(disk_cache::load("fieldpattern", key, [&] (hstream& hs) {
+      hread(hs, res);
+      if(res == 0) hread_fpattern(hs, *this);
+      })) {
+      rotations = 4; local_group = 24; dual = 0;
+      return res;
+      }
+    res = solve_search();
+    disk_cache::save("fieldpattern", key, [&] (hstream& hs) {
+      hwrite(hs, res);
+      if(res == 0) hwrite_fpattern(hs, *this);
+      });
+    return res;
+    }
+  #endif
+  return solve_search();
+  }
+
+int fpattern::solve_search() {
   
   for(int a=0; a<MWDIM; a++) for(int b=0; b<MWDIM; b++) Id[a][b] = a==b?1:0;
 
@@ -1283,14 +1323,15 @@ EX void field_from_current() {
 EX map<string, discovery> discoveries;
 
 void discovery::activate() {
-  if(!discoverer) {
-    discoverer = std::make_shared<std::thread> ( [this] {
+  if(!started) {
+    started = true;
+    discoverer.run([this] {
       for(int p=2; p<100; p++) {
         experiment.Prime = p;
         experiment.solve();
         if(stop_it) break;
         }
-      });
+      }, true);
     }
   if(is_suspended) {
     if(1) {
@@ -1315,7 +1356,8 @@ void discovery::check_suspend() {
   }
 
 void discovery::schedule_destruction() { stop_it = true; }
-discovery::~discovery() { schedule_destruction(); if(discoverer) discoverer->join(); }
+/* join, not wait: a failed search must not throw out of the destructor */
+discovery::~discovery() { schedule_destruction(); discoverer.join(); }
 #endif
 
 int hk = 
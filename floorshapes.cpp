@@ -25,6 +25,8 @@ extern qfloorinfo qfi;
 EX vector<basic_textureinfo> floor_texture_vertices;
 EX vector<glvertex> floor_texture_map;
 EX struct renderbuffer *floor_textures;
+/** increased whenever floor_textures is created again */
+EX int floor_textures_generation;
 
 void geometry_information::init_floorshapes() {
   all_escher_floorshapes.clear();
@@ -1161,6 +1163,7 @@ void geometry_information::make_floor_textures_here() {
   dynamicval<ld> lw(vid.linewidth, 2);
 
   floor_textures = new renderbuffer(vid.xres, vid.yres, vid.usingGL);
+  floor_textures_generation++;
   resetbuffer rb;
 
   int q = isize(all_escher_floorshapes) + isize(all_plain_floorshapes);
@@ -417,7 +417,7 @@ EX void showQuotientConfig3() {
   
   auto& ds = discoveries[cginf.tiling_name];
   
-  if(!ds.discoverer) {
+  if(!ds.started) {
     dialog::addItem("start discovery", 's');
     dialog::add_action([&ds] { ds.activate(); });
     }
@@ -1127,6 +1127,11 @@ int read_geom_args() {
     shift(); gp::param.second = argi();
     set_variation(eVariation::goldberg);
     }
+  /* e.g. -gp-bench 100000 */
+  else if(argis("-gp-bench")) {
+    PHASE(3);
+    shift(); gp::creation_benchmark(argi());
+    }
   else if(argis("-unrectified")) {
     PHASEFROM(2);
     set_variation(eVariation::unrectified);
@@ -121,15 +121,105 @@ transmatrix hrmap_standard::relative_matrix(cell *c2, cell *c1, const hyperpoint
   return gm * U * where;
   }
 
+/** should hrmap_standard::relative_matrix use relative_matrix_cache in hyperbolic tilings */
+EX bool relative_matrix_caching = true;
+
+/** the number of jump pointers kept before relative_matrix_cache is reset */
+EX int relative_matrix_cache_limit = 65536;
+
+/** the jump pointer for h, computing it (and those of its uncached ancestors) if needed; nullptr if move(0) does not lead to the origin */
+relative_matrix_cache::ancestor* hrmap_standard::get_ancestor(heptagon *h) {
+  auto& anc = rm_cache.ancestors;
+  int id = anc.index_of(h);
+  if(id >= 0) return &anc.at_index(id).second;
+  auto& chain = rm_cache.chain;
+  chain.clear();
+  while(h->distance > 0 && anc.index_of(h) < 0) {
+    heptagon *p = h->move(0);
+    if(!p || p->distance >= h->distance) return nullptr;
+    chain.push_back(h);
+    h = p;
+    }
+  relative_matrix_cache::ancestor *res = nullptr;
+  for(int i=isize(chain)-1; i>=0; i--) {
+    heptagon *h = chain[i];
+    heptagon *p = h->move(0);
+    relative_matrix_cache::ancestor a;
+    a.jump = p; a.depth = 1; a.T = adj(h, 0); a.Ti = iadj(h, 0);
+    if(p->distance > 0) {
+      auto& ap = anc.at_index(anc.index_of(p)).second;
+      a.depth = ap.depth + 1;
+      heptagon *jp = ap.jump;
+      if(jp->distance > 0) {
+        auto& ajp = anc.at_index(anc.index_of(jp)).second;
+        int jjdepth = ajp.jump->distance > 0 ? anc.at_index(anc.index_of(ajp.jump)).second.depth : 0;
+        if(ap.depth - ajp.depth == ajp.depth - jjdepth) {
+          a.jump = ajp.jump;
+          a.T = a.T * ap.T * ajp.T;
+          a.Ti = ajp.Ti * ap.Ti * a.Ti;
+          }
+        }
+      }
+    res = &(anc[h] = a);
+    }
+  return res;
+  }
+
+/** move h up (via move(0)) until its distance is at most target, multiplying gm on the right by adj, or where on the left by iadj */
+bool hrmap_standard::lift(heptagon*& h, int target, transmatrix *gm, transmatrix *where) {
+  while(h->distance > target) {
+    auto a = get_ancestor(h);
+    if(!a) return false;
+    if(a->jump->distance >= target) {
+      if(gm) *gm = *gm * a->T;
+      if(where) *where = a->Ti * *where;
+      h = a->jump;
+      }
+    else {
+      if(gm) *gm = *gm * adj(h, 0);
+      if(where) *where = iadj(h, 0) * *where;
+      h = h->move(0);
+      }
+    }
+  return true;
+  }
+
 transmatrix hrmap_standard::relative_matrix(heptagon *h2, heptagon *h1, const hyperpoint& hint) {
 
+  #if CAP_CRYSTAL
+  if(cryst) return relative_matrix_crystal(h2, h1);
+  #endif
+
   transmatrix gm = Id, where = Id;
   // always add to last!
 //bool hsol = false;
 //transmatrix sol;
 
-  set<heptagon*> visited;
-  map<ld, vector<pair<heptagon*, transmatrix>>> hbdist;
+  relative_matrix_cache::memo *memo = nullptr;
+  heptagon *h1_orig = h1, *h2_orig = h2;
+
+  if(relative_matrix_caching && hyperbolic && !bounded) {
+    auto& rc = rm_cache;
+    if(rc.deletions != heptagon_deletions || rc.ancestors.size() > relative_matrix_cache_limit) {
+      rc.deletions = heptagon_deletions;
+      rc.ancestors.clear();
+      rc.memos.assign(1024, relative_matrix_cache::memo{nullptr, nullptr, Id});
+      heptagon *o = getOrigin();
+      rc.max_gap = 1;
+      for(int d=0; d<o->type; d++) rc.max_gap = max(rc.max_gap, abs(o->cmove(d)->distance - o->distance));
+      }
+    memo = &rc.memos[((uintptr_t(h1) >> 4) * 31 + (uintptr_t(h2) >> 4)) & 1023];
+    if(memo->h1 == h1 && memo->h2 == h2) return memo->T;
+
+    /* heptagons whose distances differ by more than max_gap cannot be adjacent, so jump until this is no longer the case */
+    bool ok = true;
+    if(h1->distance > h2->distance + rc.max_gap) ok = lift(h1, h2->distance + rc.max_gap, &gm, nullptr);
+    else if(h2->distance > h1->distance + rc.max_gap) ok = lift(h2, h1->distance + rc.max_gap, nullptr, &where);
+    if(!ok) {
+      h1 = h1_orig, h2 = h2_orig, gm = Id, where = Id;
+      memo = nullptr;
+      }
+    }
 
   int steps = 0;
   while(h1 != h2) {
@@ -157,7 +247,8 @@ transmatrix hrmap_standard::relative_matrix(heptagon *h2, heptagon *h1, const hy
       if(bestdist < 1e8) return T;
       }
     for(int d=0; d<h1->type; d++) if(h1->move(d) == h2) {
-      return gm * adj(h1, d) * where;
+      gm = gm * adj(h1, d);
+      goto done;
       }
     if(among(geometry, gFieldQuotient, gBring, gMacbeath)) {
       int bestdist = 1000000, bestd = 0;
@@ -168,21 +259,6 @@ transmatrix hrmap_standard::relative_matrix(heptagon *h2, heptagon *h1, const hy
       gm = gm * adj(h1, bestd);
       h1 = h1->move(bestd);
       }
-    #if CAP_CRYSTAL
-    else if(cryst) {
-      for(int d3=0; d3<S7; d3++) {
-        auto hm = h1->cmove(d3);
-        if(visited.count(hm)) continue;
-        visited.insert(hm);
-        ld dist = crystal::space_distance(hm->c7, h2->c7);
-        hbdist[dist].emplace_back(hm, gm * adj(h1, d3));
-        }
-      auto &bestv = hbdist.begin()->second;
-      tie(h1, gm) = bestv.back();
-      bestv.pop_back();
-      if(bestv.empty()) hbdist.erase(hbdist.begin());
-      }
-    #endif
     else if(h1->distance < h2->distance) {
       where = iadj(h2, 0) * where;
       h2 = h2->move(0);
@@ -192,9 +268,46 @@ transmatrix hrmap_standard::relative_matrix(heptagon *h2, heptagon *h1, const hy
       h1 = h1->move(0);
       }
     }
+  done:
+  if(memo) {
+    memo->h1 = h1_orig; memo->h2 = h2_orig;
+    memo->T = gm * where;
+    return memo->T;
+    }
   return gm * where;
   }
 
+#if CAP_CRYSTAL
+/** in crystals, follow the heptagons which are the closest to h2 in the crystal space */
+transmatrix hrmap_standard::relative_matrix_crystal(heptagon *h2, heptagon *h1) {
+  transmatrix gm = Id;
+  set<heptagon*> visited;
+  map<ld, vector<pair<heptagon*, transmatrix>>> hbdist;
+
+  int steps = 0;
+  while(h1 != h2) {
+    steps++; if(steps > 10000) {
+      println(hlog, "not found"); return Id; 
+      }
+    for(int d=0; d<h1->type; d++) if(h1->move(d) == h2) {
+      return gm * adj(h1, d);
+      }
+    for(int d3=0; d3<S7; d3++) {
+      auto hm = h1->cmove(d3);
+      if(visited.count(hm)) continue;
+      visited.insert(hm);
+      ld dist = crystal::space_distance(hm->c7, h2->c7);
+      hbdist[dist].emplace_back(hm, gm * adj(h1, d3));
+      }
+    auto &bestv = hbdist.begin()->second;
+    tie(h1, gm) = bestv.back();
+    bestv.pop_back();
+    if(bestv.empty()) hbdist.erase(hbdist.begin());
+    }
+  return gm;
+  }
+#endif
+
 EX shiftmatrix &ggmatrix(cell *c) {
   shiftmatrix& t = gmatrix[c];
   if(t[LDIM][LDIM] == 0) {
@@ -402,7 +515,7 @@ ld hrmap_standard::spin_angle(cell *c, int d) {
     auto id = irr::cellindex[c];
     auto& vs = irr::cells[id];
     if(d < 0 || d >= c->type) return 0;
-    auto& p = vs.jpoints[vs.neid[d]];
+    auto& p = vs.jpoints[d];
     return -atan2(p[1], p[0]) - hexshift;
     }
   else
@@ -461,7 +574,7 @@ transmatrix hrmap_standard::adj(cell *c, int i) {
   if(GOLDBERG && gp::do_adjm) {
     transmatrix T = master_relative(c, true);
     transmatrix U = master_relative(c->cmove(i), false);
-    if(gp::gp_adj.count(make_pair(c,i))) {
+    if(gp::has_adj(c, i)) {
       return T * gp::get_adj(c,i) * U;
       }
     else
@@ -603,7 +716,7 @@ EX hyperpoint nearcorner(cell *c, int i) {
   #if CAP_IRR
   if(IRREGULAR) {
     auto& vs = irr::cells[irr::cellindex[c]];
-    hyperpoint nc = vs.jpoints[vs.neid[i]];
+    hyperpoint nc = vs.jpoints[i];
     return mid_at(C0, nc, .94);
     }
   #endif
@@ -779,4 +892,68 @@ vector<hyperpoint> hrmap::get_vertices(cell* c) {
   return res;
   }
 
+
+#if CAP_COMMANDLINE
+/** queries per second of relative_matrix between heptagons at distance d on random outward paths, for d = 1, 2, 4, ..., maxd */
+void relative_matrix_benchmark(int maxd) {
+  heptagon *origin = currentmap->getOrigin();
+  vector<vector<heptagon*>> paths(64);
+  for(auto& p: paths) {
+    p.push_back(origin);
+    while(isize(p) < 2 * maxd + 1) {
+      heptagon *at = p.back();
+      vector<int> dirs;
+      for(int d=0; d<at->type; d++) if(at->cmove(d)->distance > at->distance) dirs.push_back(d);
+      if(dirs.empty()) break;
+      p.push_back(at->cmove(hrand_elt(dirs)));
+      }
+    }
+  for(int d=1; d<=maxd; d*=2) {
+    vector<pair<heptagon*, heptagon*>> pairs;
+    for(auto& p: paths) for(int i=0; i+d<isize(p); i++) pairs.emplace_back(p[i+d], p[i]);
+    if(pairs.empty()) break;
+    ld err = 0;
+    for(auto& pr: pairs) {
+      transmatrix T[2];
+      for(int c: {0, 1}) {
+        dynamicval<bool> rmc(relative_matrix_caching, c);
+        T[c] = currentmap->relative_matrix(pr.first, pr.second, C0);
+        }
+      for(int i=0; i<MDIM; i++) for(int j=0; j<MDIM; j++) err = max(err, abs(T[0][i][j] - T[1][i][j]) / max<ld>(1, abs(T[0][i][j])));
+      }
+    print(hlog, "distance ", d, ": relative error ", err, ",");
+    for(bool caching: {false, true}) {
+      dynamicval<bool> rmc(relative_matrix_caching, caching);
+      int t0 = SDL_GetTicks(), t1 = t0;
+      long long q = 0;
+      ld total = 0;
+      while(t1 - t0 < 250) {
+        for(int k=0; k<256; k++, q++) {
+          auto& pr = pairs[q % isize(pairs)];
+          total += currentmap->relative_matrix(pr.first, pr.second, C0)[LDIM][LDIM];
+          }
+        t1 = SDL_GetTicks();
+        }
+      print(hlog, caching ? " cached " : " uncached ", int(q * 1000. / max(t1 - t0, 1)), " q/s");
+      if(total < 0) print(hlog, "!");
+      }
+    println(hlog);
+    }
+  }
+
+int geometry2_args() {
+  using namespace arg;
+  if(0) ;
+  /* e.g. -relmatrix-bench 64 */
+  else if(argis("-relmatrix-bench")) {
+    PHASEFROM(2);
+    start_game();
+    shift(); relative_matrix_benchmark(argi());
+    }
+  else return 1;
+  return 0;
+  }
+
+auto geometry2_hook = addHook(hooks_args, 100, geometry2_args);
+#endif
   }
@@ -109,11 +109,7 @@ EX namespace gp {
       ((li.last_dir & 15) << 12);
     }
   
-  EX local_info get_local_info(cell *c) {
-    if(INVERSE) {
-      c = get_mapped(c);
-      return UIU(get_local_info(c));
-      }
+  local_info compute_local_info(cell *c) {
     local_info li;
     if(c == c->master->c7) {
       li.relative = loc(0,0);
@@ -144,6 +140,45 @@ EX namespace gp {
       }
     return li;
     }
+
+  /** local_info, packed; it depends only on the chain of move(0) links to the master, which never changes for an existing cell */
+  struct packed_local_info {
+    short rx, ry, total_dir;
+    signed char last_dir, first_dir;
+    };
+
+  cell_index<packed_local_info> local_info_cache;
+
+  /** the value of cell_deletions when local_info_cache was last valid */
+  int local_info_deletions = -1;
+
+  EX local_info get_local_info(cell *c) {
+    if(INVERSE) {
+      c = get_mapped(c);
+      return UIU(get_local_info(c));
+      }
+    if(local_info_deletions != cell_deletions) {
+      local_info_cache.clear();
+      local_info_deletions = cell_deletions;
+      }
+    local_info li;
+    int id = local_info_cache.index_of(c);
+    if(id >= 0) {
+      auto& p = local_info_cache.at_index(id).second;
+      li.relative = loc(p.rx, p.ry);
+      li.total_dir = p.total_dir;
+      li.last_dir = p.last_dir;
+      li.first_dir = p.first_dir;
+      return li;
+      }
+    li = compute_local_info(c);
+    auto& p = local_info_cache[c];
+    p.rx = li.relative.first; p.ry = li.relative.second;
+    p.total_dir = li.total_dir;
+    p.last_dir = li.last_dir;
+    p.first_dir = li.first_dir;
+    return li;
+    }
     
   EX int last_dir(cell *c) {
     return get_local_info(c).last_dir;
@@ -273,9 +308,40 @@ EX namespace gp {
     conn1(at + eudir(dir), fixg6(dir+SG3), fixg6(dir));
     }
   
-  EX map<pair<cell*, int>, transmatrix> gp_adj;
-  
-  EX transmatrix& get_adj(cell *c, int i) { return gp_adj[make_pair(c,i)]; }
+  /** the adjacency matrices for do_adjm: the matrices of the c->type directions of c are consecutive in gp_adj, starting at gp_adj_first[c] */
+  struct adj_slot {
+    bool known;
+    transmatrix T;
+    };
+
+  cell_index<int> gp_adj_first;
+  vector<adj_slot> gp_adj;
+
+  adj_slot& get_adj_slot(cell *c, int i) {
+    int id = gp_adj_first.index_of(c);
+    if(id >= 0) return gp_adj[gp_adj_first.at_index(id).second + i];
+    int first = isize(gp_adj);
+    gp_adj_first[c] = first;
+    gp_adj.resize(first + c->type, adj_slot{false, transmatrix()});
+    return gp_adj[first + i];
+    }
+
+  /** the reference is valid until get_adj is called for another cell */
+  EX transmatrix& get_adj(cell *c, int i) {
+    auto& s = get_adj_slot(c, i);
+    s.known = true;
+    return s.T;
+    }
+
+  EX bool has_adj(cell *c, int i) {
+    int id = gp_adj_first.index_of(c);
+    return id >= 0 && gp_adj[gp_adj_first.at_index(id).second + i].known;
+    }
+
+  EX void clear_adj() {
+    gp_adj_first.clear();
+    gp_adj.clear();
+    }
 
   goldberg_mapping_t& set_heptspin(loc at, heptspin hs) {
     auto& ac0 = get_mapping(at);
@@ -1045,6 +1111,33 @@ EX namespace gp {
       return make_array(c->cmove(0)->master, c->cmove(2)->master, c->cmove(4)->master);
     }
 
+  /** for each of a range of Goldberg parameters, create qty cells of the current geometry, and time
+   *  the generation, the local_info queries, and the adjacency matrices */
+  EX void creation_benchmark(int qty) {
+    vector<loc> params = {loc(2,0), loc(2,1), loc(3,2), loc(4,3), loc(6,3), loc(8,5)};
+    for(auto p: params) {
+      stop_game();
+      param = p;
+      set_variation(eVariation::goldberg);
+      start_game();
+      int t0 = SDL_GetTicks();
+      celllister cl(cwt.at, 1000, qty, NULL);
+      int t1 = SDL_GetTicks();
+      unsigned hash = 0;
+      for(int it=0; it<10; it++) for(cell *c: cl.lst) {
+        hash = hash * 31 + get_code(get_local_info(c));
+        hash = hash * 31 + pseudohept_val(c);
+        }
+      int t2 = SDL_GetTicks();
+      for(cell *c: cl.lst) for(int i=0; i<c->type; i++) if(c->move(i)) {
+        transmatrix T = currentmap->adj(c, i);
+        hash = hash * 31 + int(T[0][LDIM] * 1e6);
+        }
+      int t3 = SDL_GetTicks();
+      println(hlog, "GP", p, ": cells = ", isize(cl.lst), " generation = ", t1-t0, " ms, local_info = ", t2-t1, " ms, adj = ", t3-t2, " ms, hash = ", hash);
+      }
+    }
+
   EX string operation_name() {
     if(0);
     #if CAP_IRR
@@ -4571,6 +4571,7 @@ EX void drawthemap() {
   cgi.require_shapes();
 
   DEBBI(DF_GRAPH, ("draw the map"));
+  PROFILE_ZONE("drawthemap");
   
   last_firelimit = firelimit;
   firelimit = 0;
@@ -4589,8 +4590,6 @@ EX void drawthemap() {
   if(sightrange_bonus > 0 && !allowIncreasedSight()) 
     sightrange_bonus = 0;
   
-  profile_frame();
-  profile_start(0);
   swap(gmatrix0, gmatrix);
   gmatrix.clear();
   current_display->all_drawn_copies.clear();
@@ -4662,7 +4661,6 @@ EX void drawthemap() {
   
   arrowtraps.clear();
 
-  profile_start(1);
   make_actual_view();
   currentmap->draw_all();
   drawWormSegments();
@@ -4677,10 +4675,7 @@ EX void drawthemap() {
   
   callhooks(hooks_frame);
   
-  profile_stop(1);
-  profile_start(4);
   drawMarkers();
-  profile_stop(4);
   drawFlashes();
   
   mapeditor::draw_dtshapes();
@@ -4738,7 +4733,6 @@ EX void drawthemap() {
     lmouseover = mousedest.d >= 0 ? cwt.at->modmove(cwt.spin + mousedest.d) : cwt.at;
     }
   #endif
-  profile_stop(0);
   }
 
 EX void drawmovestar(double dx, double dy) {
@@ -4869,13 +4863,101 @@ EX function<void()> wrap_drawfullmap = drawfullmap;
 
 bool force_sphere_outline = false;
 
+/** reuse the draw queue of the previous frame if nothing has changed: 0 = never, 1 = in menus,
+ *  2 = also in the normal mode. The time is not a part of frame_state, so the time-based
+ *  animations of the map (water, fire, moving walls, etc.) stop while a frame is reused;
+ *  this is why it is off by default */
+EX int frame_reuse = 0;
+
+/** frames drawn from the saved draw queue, and frames for which the draw queue was built */
+EX int frames_reused, frames_rebuilt;
+
+/** bumped on every input event, since the input may change anything that is drawn */
+EX int input_events;
+
+/** what the map layer depends on, other than the time */
+struct frame_state {
+  transmatrix view;
+  cell *center;
+  int cmode, darken, xres, yres, xcenter, ycenter, turncount, input_events;
+  ld radius;
+  eModel model;
+  bool operator == (const frame_state& f) const {
+    return eqmatrix(view, f.view, 0) && center == f.center && cmode == f.cmode && darken == f.darken &&
+      xres == f.xres && yres == f.yres && xcenter == f.xcenter && ycenter == f.ycenter &&
+      turncount == f.turncount && input_events == f.input_events && radius == f.radius && model == f.model;
+    }
+  };
+
+frame_state current_frame_state() {
+  frame_state f;
+  f.view = View; f.center = centerover;
+  f.cmode = cmode; f.darken = darken;
+  f.xres = vid.xres; f.yres = vid.yres;
+  f.xcenter = current_display->xcenter; f.ycenter = current_display->ycenter;
+  f.turncount = turncount; f.input_events = input_events;
+  f.radius = current_display->radius;
+  f.model = pmodel;
+  return f;
+  }
+
+/** the saved frame: the draw queue after drawqueue, with the curve and aura data it needs */
+struct saved_frame {
+  bool valid;
+  frame_state state;
+  vector<unique_ptr<drawqueueitem>> ptds;
+  vector<glvertex> curvedata;
+  array<array<int,4>,AURA+1> aurac;
+  vector<pair<int, int> > auraspecials;
+  } saved;
+
+/** can the current frame be saved or reused at all; the state is checked separately */
+bool frame_reusable() {
+  if(frame_reuse == 0 || inHighQual || GDIM == 3 || svg::in || nomap) return false;
+  if(cmode & sm::NORMAL) {
+    if(frame_reuse < 2 || shmup::on || multi::players > 1 || racing::on) return false;
+    }
+  #if CAP_TOUR
+  if(tour::on) return false;
+  #endif
+  #if CAP_ANIMATIONS
+  if(anims::any_on()) return false;
+  #endif
+  for(auto& a: animations) if(!a.empty()) return false;
+  if(!flashes.empty() || (lightat && ticks <= lightat + 1000) || safetyat) return false;
+  return true;
+  }
+
 EX void drawfullmap() {
 
   DEBBI(DF_GRAPH, ("draw full map"));
+  profile_frame();
+  PROFILE_ZONE("drawfullmap");
     
   check_cgi();
   cgi.require_shapes();
 
+  bool reusable = frame_reusable();
+  if(!reusable) saved.valid = false;
+  frame_state state;
+  if(reusable) state = current_frame_state();
+
+  if(reusable && saved.valid && saved.state == state) {
+    frames_reused++;
+    swap(ptds, saved.ptds);
+    curvedata = saved.curvedata;
+    aurac = saved.aurac;
+    auraspecials = saved.auraspecials;
+    drawaura();
+    #if CAP_QUEUE
+    drawqueue();
+    #endif
+    swap(ptds, saved.ptds);
+    ptds.clear();
+    return;
+    }
+  frames_rebuilt++;
+
   ptds.clear();
 
   
@@ -4924,14 +5006,26 @@ EX void drawfullmap() {
     if(cmode & sm::DRAW) mapeditor::drawGrid();
 #endif
     }
-  profile_start(2);
+
+  /* cells generated in this frame are drawn only in the next one */
+  saved.valid = reusable && !cells_generated;
+  if(saved.valid) {
+    saved.state = state;
+    saved.curvedata = curvedata;
+    saved.aurac = aurac;
+    saved.auraspecials = auraspecials;
+    }
 
   drawaura();
   #if CAP_QUEUE
   drawqueue();
   #endif
 
-  profile_stop(2);
+  if(saved.valid) {
+    swap(ptds, saved.ptds);
+    ptds.clear();
+    }
+  else saved.ptds.clear();
   }
 
 #if ISMOBILE
@@ -5178,6 +5272,10 @@ EX void drawscreen() {
 
   // SDL_UnlockSurface(s);
 
+  #if CAP_PROFILING
+  if(profiler::overlay) profiler::draw_overlay();
+  #endif
+
   glflush();
   DEBB(DF_GRAPH, ("swapbuffers"));
 #if CAP_SDL
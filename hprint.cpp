@@ -141,6 +141,7 @@ struct shstream : hstream {
   shstream(const string& t = "") : s(t) { pos = 0; vernum = VERNUM_HEX; }
   virtual void write_char(char c) override { s += c; }
   virtual char read_char() override { if(pos == isize(s)) throw hstream_exception(); return s[pos++]; }
+  virtual void read_chars(char* c, size_t q) override { if(pos + q > s.size()) throw hstream_exception(); memcpy(c, &s[pos], q); pos += q; }
   };
 
 inline void print(hstream& hs) {}
@@ -25,6 +25,7 @@ EX int cellcount;
 struct cellinfo {
   cell *owner;
   map<cell*, transmatrix> relmatrices;
+  /** the positions of the neighbors neid[i], relative to this cell */
   vector<hyperpoint> jpoints;
   hyperpoint p;
   transmatrix pusher, rpusher;
@@ -134,6 +135,9 @@ EX int bitruncations_performed = 0;
 
 int black_adjacent, white_three;
 
+/** statistics for creation_benchmark */
+int voronoi_rounds, placement_ticks, voronoi_ticks;
+
 void set_relmatrices(cellinfo& ci) {
   auto& all = base->allcells();
   ci.relmatrices.clear();
@@ -149,19 +153,158 @@ void rebase(cellinfo& ci) {
     }
   }
 
-void compute_jpoints() {
-  for(int i=0; i<isize(cells); i++) {
-    auto &ci = cells[i];
+/** the Voronoi sites (cells), grouped by the cell of the base map which owns them */
+struct site_groups {
+  vector<cell*> owners;
+  vector<vector<int>> members;
+  /** the largest hdist0 of a member, so that the members of owners[b] are within radius[b] of owners[b]'s center */
+  vector<ld> radius;
+  map<cell*, int> id;
+
+  site_groups() {
+    owners = base->allcells();
+    for(int b=0; b<isize(owners); b++) id[owners[b]] = b;
+    members.resize(isize(owners));
+    radius.resize(isize(owners), 0);
+    }
 
-    ci.pusher = rgpushxto0(ci.p);
-    ci.rpusher = gpushxto0(ci.p);
+  void add(int k) {
+    int b = id.at(cells[k].owner);
+    members[b].push_back(k);
+    radius[b] = max(radius[b], hdist0(cells[k].p));
+    }
+  };
+
+/** the distance from h to the nearest site, where relmatrices are the relative matrices of the base cells as seen from h */
+ld nearest_site(hyperpoint h, map<cell*, transmatrix>& relmatrices, const site_groups& g) {
+  vector<pair<ld, int>> order;
+  for(int b=0; b<isize(g.owners); b++) if(!g.members[b].empty())
+    order.emplace_back(hdist(h, relmatrices[g.owners[b]] * C0) - g.radius[b], b);
+  sort(order.begin(), order.end());
+  ld mindist = 1e6;
+  for(auto& o: order) {
+    /* no site in this base cell or the following ones can be closer */
+    if(o.first > mindist + 1e-6) break;
+    auto& T = relmatrices[g.owners[o.second]];
+    for(int k: g.members[o.second]) {
+      ld val = hdist(h, T * cells[k].p);
+      if(val < mindist) mindist = val;
+      }
+    }
+  /* the cell being placed is not in g yet, but its best position so far counts too */
+  auto& last = cells.back();
+  if(last.owner) mindist = min(mindist, hdist(h, relmatrices[last.owner] * last.p));
+  return mindist;
+  }
+
+/** walk around the Voronoi cell of cells[i], using only the given sites (sorted by index, with positions relative to cells[i]);
+ *  returns false if the walk did not close properly */
+bool voronoi_walk(int i, const vector<pair<int, hyperpoint>>& sites, vector<int>& nei) {
+  auto &p1 = cells[i];
+  p1.vertices.clear();
+  nei.clear();
+  int n = isize(sites);
+
+  int j = 0;
+  if(sites[j].first == i) j = 1;
+
+  for(int k=0; k<n; k++) if(sites[k].first != i) {
+    if(hdist(sites[k].second, C0) < hdist(sites[j].second, C0))
+      j = k;
+    }
     
-    ci.jpoints.clear();
+  hyperpoint t = mid(sites[j].second, C0);
+  int j0 = j;
+  int oldj = j;
+  do {
+    int best_k = -1;
+    hyperpoint best_h = t; /* if no vertex is found, the last one is repeated */
+    for(int k=0; k<n; k++) if(sites[k].first != i && k != j && k != oldj) {
+      hyperpoint h = circumscribe(C0, sites[j].second, sites[k].second);
+      if(h[LDIM] < 0) continue;
+      if(!clockwise(t, h)) continue;
+      if(best_k == -1)
+        best_k = k, best_h = h;
+      else if(clockwise(h, best_h))
+        best_k = k, best_h = h;
+      }
+    p1.vertices.push_back(best_h);
+    nei.push_back(best_k);
+    oldj = j, j = best_k, t = best_h;
+    if(j == -1) return false;
+    if(isize(p1.vertices) == 15) return false;
+    }
+  while(j != j0);
+  return true;
+  }
 
-    for(int j=0; j<isize(cells); j++) {
-      auto &cj = cells[j];
-      ci.jpoints.push_back(ci.rpusher * ci.relmatrices[cj.owner] * cj.p);
+/** compute the Voronoi cell of cells[i]
+ *
+ *  Only the sites which could matter are considered: a site at distance d from cells[i] can only affect the cell
+ *  if d is at most twice the distance to the farthest vertex. So the cell is first computed from the sites within
+ *  some bound, and recomputed with a larger bound until the bound covers twice the distance to every vertex.
+ *  Base cells are only looked into if the lower bound of the distance to their sites is within the bound.
+ *  On the sphere this argument does not work, so all the sites are used.
+ */
+void voronoi_cell(int i, const site_groups& g) {
+  auto &p1 = cells[i];
+  p1.pusher = rgpushxto0(p1.p);
+  p1.rpusher = gpushxto0(p1.p);
+  
+  int qb = isize(g.owners);
+  vector<transmatrix> rel(qb);
+  vector<pair<ld, int>> order;
+  for(int b=0; b<qb; b++) if(!g.members[b].empty()) {
+    rel[b] = p1.rpusher * p1.relmatrices.at(g.owners[b]);
+    order.emplace_back(hdist0(tC0(rel[b])) - g.radius[b], b);
+    }
+  sort(order.begin(), order.end());
+  
+  struct site { int id; hyperpoint h; ld dist; };
+  vector<site> pool;
+  int used = 0;
+  auto include = [&] (ld bound) {
+    while(used < isize(order) && order[used].first <= bound) {
+      int b = order[used++].second;
+      for(int k: g.members[b]) {
+        hyperpoint h = rel[b] * cells[k].p;
+        pool.push_back(site{k, h, hdist0(h)});
+        }
       }
+    };
+
+  const ld infinity = 1e10;
+  ld bound = infinity;
+  if(!sphere) {
+    /* start with a few times the distance to the nearest site in the closest base cells */
+    include(order[0].first);
+    ld nearest = infinity;
+    for(auto& s: pool) if(s.id != i) nearest = min(nearest, s.dist);
+    bound = 3 * nearest;
+    }
+  
+  vector<pair<int, hyperpoint>> sites;
+  vector<int> nei;
+  while(true) {
+    include(bound);
+    sites.clear();
+    for(auto& s: pool) if(s.dist <= bound) sites.emplace_back(s.id, s.h);
+    if(isize(sites) < 2 && bound < infinity) { bound = infinity; continue; }
+    sort(sites.begin(), sites.end(), [] (const pair<int, hyperpoint>& a, const pair<int, hyperpoint>& b) { return a.first < b.first; });
+    bool ok = voronoi_walk(i, sites, nei);
+    if(bound >= infinity) break;
+    if(!ok) { bound = infinity; continue; }
+    ld r = 0;
+    for(auto& v: p1.vertices) r = max(r, hdist0(v));
+    if(2 * r + 1e-3 <= bound) break;
+    bound = 2 * r + 1e-3;
+    }
+  
+  p1.neid.clear();
+  p1.jpoints.clear();
+  for(int k: nei) {
+    p1.neid.push_back(k == -1 ? -1 : sites[k].first);
+    p1.jpoints.push_back(k == -1 ? C0 : sites[k].second);
     }
   }
     
@@ -211,10 +354,10 @@ void bitruncate() {
     cells[i].neid = move(newnei);
     }
   make_cells_of_heptagon();
-  compute_jpoints();
   for(int i=0; i<isize(cells); i++) {
     auto &ci = cells[i];
     ci.vertices.clear();
+    ci.jpoints.clear();
 
     ci.pusher = rgpushxto0(ci.p);
     ci.rpusher = gpushxto0(ci.p);
@@ -226,6 +369,7 @@ void bitruncate() {
       hyperpoint h1 = ci.rpusher * ci.relmatrices[cells[last].owner] * cells[last].p;
       hyperpoint h2 = ci.rpusher * ci.relmatrices[cells[next].owner] * cells[next].p;
       ci.vertices.push_back(mid3(C0, h1, h2));
+      ci.jpoints.push_back(h2);
       }
     }
   bitruncations_performed++;
@@ -283,8 +427,11 @@ bool step(int delta) {
       }
      
     case 1: {
+      auto t1 = SDL_GetTicks();
+      site_groups g;
+      for(int k=0; k<isize(cells); k++) g.add(k);
       while(isize(cells) < cellcount) {
-        if(SDL_GetTicks() > t + 250) { make_cells_of_heptagon(); status[0] = its(isize(cells)) + " cells"; return false; }
+        if(SDL_GetTicks() > t + 250) { make_cells_of_heptagon(); status[0] = its(isize(cells)) + " cells"; placement_ticks += SDL_GetTicks() - t1; return false; }
         cells.emplace_back();
         cellinfo& s = cells.back();
         s.patterndir = -1;
@@ -295,17 +442,14 @@ bool step(int delta) {
           map<cell*, transmatrix> relmatrices;
           hyperpoint h = randomPointIn(c->type);
           for(auto c0: all) relmatrices[c0] = calc_relative_matrix(c0, c, h);
-          ld mindist = 1e6;
-          for(auto p: cells) {
-            if(!relmatrices.count(p.owner)) continue;
-            ld val = hdist(h, relmatrices[p.owner] * p.p);
-            if(val < mindist) mindist = val;
-            }
+          ld mindist = nearest_site(h, relmatrices, g);
           if(mindist > bestval) bestval = mindist, s.owner = c, s.p = h, s.relmatrices = move(relmatrices);
           }
+        if(s.owner) g.add(isize(cells)-1);
         }
       make_cells_of_heptagon();
       cell_sorting = true; bitruncations_performed = 0;
+      placement_ticks += SDL_GetTicks() - t1;
       runlevel++;
       status[0] = "all " + its(isize(cells)) + " cells";
       break;
@@ -313,6 +457,8 @@ bool step(int delta) {
     
     case 2: {
 
+      auto t1 = SDL_GetTicks();
+      voronoi_rounds++;
       if(cell_sorting)
         sort(cells.begin(), cells.end(), [] (const cellinfo &s1, const cellinfo &s2) { return hdist0(s1.p) < hdist0(s2.p); });
       make_cells_of_heptagon();
@@ -323,50 +469,18 @@ bool step(int delta) {
       int stats[16];
       for(int k=0; k<16; k++) stats[k] = 0;
       
-      compute_jpoints();
+      {
+      site_groups g;
+      for(int k=0; k<isize(cells); k++) g.add(k);
+      workers::parallel_for(0, isize(cells), 16, [&] (int a, int b) {
+        for(int i=a; i<b; i++) voronoi_cell(i, g);
+        });
+      }
       
-      for(int i=0; i<isize(cells); i++) {
-        auto &p1 = cells[i];
-    
-        p1.vertices.clear();
-        p1.neid.clear();
-    
-        int j = 0;
-        if(j == i) j = 1;
-    
-        for(int k=0; k<isize(cells); k++) if(k != i) {
-          if(hdist(p1.jpoints[k], C0) < hdist(p1.jpoints[j], C0))
-            j = k;
-          }
-          
-        hyperpoint t = mid(p1.jpoints[j], C0);
-              // p1.vertices.push_back(p1.pusher * t);
-        int j0 = j;
-        int oldj = j;
-        do {
-          int best_k = -1;
-          hyperpoint best_h;
-          for(int k=0; k<isize(cells); k++) if(k != i && k != j && k != oldj) {
-            hyperpoint h = circumscribe(C0, p1.jpoints[j], p1.jpoints[k]);
-            if(h[LDIM] < 0) continue;
-            if(!clockwise(t, h)) continue;
-            if(best_k == -1)
-              best_k = k, best_h = h;
-            else if(clockwise(h, best_h))
-              best_k = k, best_h = h;
-            }
-          p1.vertices.push_back(best_h);
-          p1.neid.push_back(best_k);
-          distlens.push_back(hdist0(best_h));
-          oldj = j, j = best_k, t = best_h;
-          if(j == -1) break;
-          if(isize(p1.vertices) == 15) break;
-          }
-        while(j != j0);
-        
+      for(auto& p1: cells) {
+        for(auto& v: p1.vertices) distlens.push_back(hdist0(v));
         for(int j=0; j<isize(p1.vertices); j++)
           edgelens.push_back(hdist(p1.vertices[j], p1.vertices[(j+1) % isize(p1.vertices)]));
-    
         stats[isize(p1.vertices)]++;
         }
     
@@ -382,6 +496,7 @@ bool step(int delta) {
         }
       printf("\n");
       
+      voronoi_ticks += SDL_GetTicks() - t1;
       runlevel++;
       break;
       }
@@ -599,6 +714,7 @@ EX void clear_links(heptagon *h) {
   for(cell *c: hi.subcells) {
     for(int i=0; i<c->type; i++) if(c->move(i)) c->move(i)->move(c->c.spin(i)) = NULL;
     cellindex.erase(c);
+    cell_deletions++;
     delete c;
     }
   h->c7 = NULL;
@@ -1049,7 +1165,27 @@ EX void auto_creator() {
   start_game_on_created_map();
   }
 
-#if CAP_COMMANDLINE  
+#if CAP_COMMANDLINE
+/** create an irregular map with cc cells from a fixed seed, and report the time taken */
+void creation_benchmark(int cc) {
+  variation = eVariation::pure;
+  bitruncations_requested = bitruncations_performed;
+  visual_creator();
+  cellcount = cc; density = cc * 1. / isize(base->allcells());
+  shrand(1); srand(1);
+  voronoi_rounds = placement_ticks = voronoi_ticks = 0;
+  int t0 = SDL_GetTicks();
+  while(runlevel < 10) step(1000);
+  int t1 = SDL_GetTicks();
+  unsigned hash = 0;
+  for(auto& ci: cells) {
+    for(int i: ci.neid) hash = hash * 31 + i;
+    hash = hash * 31 + int(ci.p[0] * 1e6);
+    }
+  println(hlog, "cellcount = ", cc, " base cells = ", isize(base->allcells()), " cells = ", isize(cells), " time = ", t1 - t0, " ms (placement ", placement_ticks, " ms, ", voronoi_rounds, " Voronoi rounds ", voronoi_ticks, " ms) hash = ", hash);
+  start_game_on_created_map();
+  }
+
 int readArgs() {
   using namespace arg;
            
@@ -1072,6 +1208,12 @@ int readArgs() {
     PHASE(2);
     shift_arg_formula(quality);
     }
+  /* e.g. -irr-bench 1000 */
+  else if(argis("-irr-bench")) {
+    PHASE(3);
+    restart_game();
+    shift(); creation_benchmark(argi());
+    }
   else if(argis("-irrload")) {
     PHASE(3);
     restart_game();
@@ -2769,6 +2769,7 @@ EX void setdist(cell *c, int d, cell *from) {
   if(fake::in()) return FPIU(setdist(c, d, from));
   
   if(c->mpdist <= d) return;
+  PROFILE_ZONE("setdist");
   if(c->mpdist > d+1 && d < BARLEV) setdist(c, d+1, from);
   c->mpdist = d;
   // printf("setdist %p %d [%p]\n", c, d, from);
@@ -1946,6 +1946,7 @@ EX void movehex_all() {
   }
   
 EX void movemonsters() {
+  PROFILE_ZONE("movemonsters");
   #if CAP_COMPLEX2
   ambush::distance = 0;
   #endif
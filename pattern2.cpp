@@ -1004,7 +1004,77 @@ EX namespace patterns {
     applyAlt(si, sub, PAT_COLORING);
     }
   
+  /** should getpatterninfo cache its results (for the patterns where this is safe, see structural_pattern) */
+  EX bool patterninfo_caching = true;
+
+  /** the cached results of getpatterninfo for one pattern and subpattern */
+  struct patterninfo_cache {
+    ePattern pat;
+    int sub;
+    cell_index<patterninfo> values;
+    };
+
+  /** the caches for the patterns in use (usually just a few, so a linear search is fine) */
+  vector<patterninfo_cache> patterninfo_caches;
+
+  /** the value of cell_deletions when patterninfo_caches were last valid */
+  int patterninfo_deletions = -1;
+
+  EX int patterninfo_hits, patterninfo_misses;
+
+  EX void clear_patterninfo_cache() {
+    patterninfo_caches.clear();
+    }
+
+  patterninfo compute_patterninfo(cell *c, ePattern pat, int sub);
+
+  patterninfo_cache& cache_for(ePattern pat, int sub) {
+    for(auto& pc: patterninfo_caches) if(pc.pat == pat && pc.sub == sub) return pc;
+    patterninfo_caches.emplace_back();
+    auto& pc = patterninfo_caches.back();
+    pc.pat = pat;
+    pc.sub = sub;
+    return pc;
+    }
+
+  /** does the pattern info for pat depend only on the structure of the map in the current geometry?
+   *  Other patterns may fall back to val_nopattern, which depends on the lands, on cpdist and on subpattern_flags */
+  bool structural_pattern(ePattern pat) {
+    switch(pat) {
+      case PAT_ZEBRA: return stdhyperbolic;
+      case PAT_EMERALD: return stdhyperbolic || a38;
+      case PAT_PALACE: return stdhyperbolic || euclid;
+      case PAT_FIELD: return CAP_FIELD;
+      default: return false;
+      }
+    }
+
+  /** the pattern info of c; for the structural patterns, it is cached once all the neighbors of c exist */
   EX patterninfo getpatterninfo(cell *c, ePattern pat, int sub) {
+    if(!patterninfo_caching || !structural_pattern(pat)) return compute_patterninfo(c, pat, sub);
+    if(patterninfo_deletions != cell_deletions) {
+      clear_patterninfo_cache();
+      patterninfo_deletions = cell_deletions;
+      }
+    auto& values = cache_for(pat, sub).values;
+    int id = values.index_of(c);
+    if(id >= 0) {
+      patterninfo_hits++;
+      return values.at_index(id).second;
+      }
+    patterninfo_misses++;
+    auto si = compute_patterninfo(c, pat, sub);
+    bool complete = true;
+    for(int i=0; i<c->type; i++) if(!c->move(i)) complete = false;
+    /* the palace pattern marks the cells where it fails with itBuggy on every call, so do not cache these */
+    if(c->item == itBuggy) complete = false;
+    /* compute_patterninfo may have added caches, invalidating the reference */
+    if(complete && patterninfo_deletions == cell_deletions)
+      cache_for(pat, sub).values[c] = si;
+    return si;
+    }
+
+  patterninfo compute_patterninfo(cell *c, ePattern pat, int sub) {
     if(fake::in()) return FPIU(getpatterninfo(c, pat, sub));
     if(!(sub & SPF_NO_SUBCODES)) {
       auto si = getpatterninfo(c, pat, sub | SPF_NO_SUBCODES);
@@ -1622,76 +1692,138 @@ EX namespace patterns {
     }
   
 
-  cld compute_map_function(cell *c, int p, const string& formula) {
-    exp_parser ep;
-    ep.extra_params["p"] = p;
-
-    hyperpoint h = calc_relative_matrix(c, currentmap->gamestart(), C0) * C0;
-    ep.extra_params["x"] = h[0];
-    ep.extra_params["y"] = h[1];
-    ep.extra_params["z"] = h[2];
-    ep.extra_params["w"] = h[3];
-    ep.extra_params["z40"] = zebra40(c);
-    ep.extra_params["z3"] = zebra3(c);
-    ep.extra_params["ev"] = emeraldval(c);
-    ep.extra_params["fv50"] = fiftyval(c);
-    ep.extra_params["pa"] = polara50(c);
-    ep.extra_params["pb"] = polarb50(c);
-    ep.extra_params["pd"] = cdist50(c);
-    ep.extra_params["fu"] = fieldpattern::fieldval_uniq(c);
-    ep.extra_params["threecolor"] = pattern_threecolor(c);
-    ep.extra_params["chess"] = chessvalue(c);
-    ep.extra_params["ph"] = pseudohept(c);
-    ep.extra_params["kph"] = kraken_pseudohept(c);
-    if(true) {
-      ep.extra_params["md"] = c->master->distance;
-      ep.extra_params["me"] = c->master->emeraldval;
-      ep.extra_params["mf"] = c->master->fieldval;
-      ep.extra_params["mz"] = c->master->zebraval;
-      }
-
-    if(sphere) {
-      ep.extra_params["h0"] = getHemisphere(c, 0);
-      ep.extra_params["h1"] = getHemisphere(c, 1);
-      ep.extra_params["h2"] = getHemisphere(c, 2);
-      }
-    if(euclid) {
+  /* the variables available to the formula canvas, in slot order */
+  enum {
+    mfP, mfX, mfY, mfZ, mfW, mfZ40, mfZ3, mfEv, mfFv50, mfPa, mfPb, mfPd, mfFu, mfThreecolor, mfChess, mfPh, mfKph,
+    mfMd, mfMe, mfMf, mfMz, mfH0, mfEx = mfH0 + 3, mfEy, mfEz, mfCrystal, mfAx = mfCrystal + crystal::MAXDIM, mfAy, mfAz,
+    mfNx, mfNy, mfNz, mfLevel, mfD0, mfCount = mfD0 + 4
+    };
+
+  /** a formula compiled for the formula canvas */
+  struct map_function {
+    string formula;
+    int available;
+    bool compiled, valid;
+    exp_program prog;
+    /** the slot of each variable in prog, or -1 if it is not available in the current geometry */
+    int slot[mfCount];
+    bool want(int id) { return slot[id] >= 0 && prog.uses(slot[id]); }
+    void set(int id, cld val) { prog.slots[slot[id]] = val; }
+    };
+
+  /** bit mask of the groups of variables available for the current geometry */
+  int map_function_available() {
+    int res = 0;
+    if(sphere) res |= 1;
+    if(euclid) res |= 2;
+    if(euclid && S7 == 6) res |= 4;
+    if(cryst) res |= 8;
+    if(asonov::in()) res |= 16;
+    if(nil) res |= 32;
+    if(hybri) res |= 64;
+    if(geometry_supports_cdata()) res |= 128;
+    return res;
+    }
+
+  /** the compiled formula; recompiled only when the formula or the set of available variables changes */
+  map_function& get_map_function(const string& formula) {
+    static map_function mf;
+    int available = map_function_available();
+    if(mf.compiled && mf.formula == formula && mf.available == available) return mf;
+    mf.compiled = true;
+    mf.formula = formula;
+    mf.available = available;
+    vector<string> names;
+    auto add = [&] (int id, const string& name, bool ok) {
+      mf.slot[id] = ok ? isize(names) : -1;
+      if(ok) names.push_back(name);
+      };
+    const char *basic[] = {"p", "x", "y", "z", "w", "z40", "z3", "ev", "fv50", "pa", "pb", "pd", "fu", "threecolor", "chess", "ph", "kph", "md", "me", "mf", "mz"};
+    for(int i=0; i<mfH0; i++) add(i, basic[i], true);
+    for(int i=0; i<3; i++) add(mfH0+i, "h" + its(i), available & 1);
+    add(mfEx, "ex", available & 2);
+    add(mfEy, "ey", available & 2);
+    add(mfEz, "ez", available & 4);
+    for(int i=0; i<crystal::MAXDIM; i++) add(mfCrystal+i, "x" + its(i), available & 8);
+    add(mfAx, "ax", available & 16);
+    add(mfAy, "ay", available & 16);
+    add(mfAz, "az", available & 16);
+    add(mfNx, "nx", available & 32);
+    add(mfNy, "ny", available & 32);
+    add(mfNz, "nz", available & 32);
+    add(mfLevel, "level", available & 64);
+    for(int i=0; i<4; i++) add(mfD0+i, "d" + its(i), available & 128);
+    try {
+      mf.prog.compile(formula, names);
+      mf.valid = true;
+      }
+    catch(hr_parse_exception& ex) {
+      mf.valid = false;
+      }
+    return mf;
+    }
+
+  /** compute the variables used by the formula, for cell c */
+  void set_map_function_variables(map_function& mf, cell *c) {
+    if(mf.want(mfX) || mf.want(mfY) || mf.want(mfZ) || mf.want(mfW)) {
+      hyperpoint h = calc_relative_matrix(c, currentmap->gamestart(), C0) * C0;
+      for(int i=0; i<4; i++) if(mf.want(mfX+i)) mf.set(mfX+i, h[i]);
+      }
+    if(mf.want(mfZ40)) mf.set(mfZ40, zebra40(c));
+    if(mf.want(mfZ3)) mf.set(mfZ3, zebra3(c));
+    if(mf.want(mfEv)) mf.set(mfEv, emeraldval(c));
+    if(mf.want(mfFv50)) mf.set(mfFv50, fiftyval(c));
+    if(mf.want(mfPa)) mf.set(mfPa, polara50(c));
+    if(mf.want(mfPb)) mf.set(mfPb, polarb50(c));
+    if(mf.want(mfPd)) mf.set(mfPd, cdist50(c));
+    if(mf.want(mfFu)) mf.set(mfFu, fieldpattern::fieldval_uniq(c));
+    if(mf.want(mfThreecolor)) mf.set(mfThreecolor, pattern_threecolor(c));
+    if(mf.want(mfChess)) mf.set(mfChess, chessvalue(c));
+    if(mf.want(mfPh)) mf.set(mfPh, pseudohept(c));
+    if(mf.want(mfKph)) mf.set(mfKph, kraken_pseudohept(c));
+    if(mf.want(mfMd)) mf.set(mfMd, c->master->distance);
+    if(mf.want(mfMe)) mf.set(mfMe, c->master->emeraldval);
+    if(mf.want(mfMf)) mf.set(mfMf, c->master->fieldval);
+    if(mf.want(mfMz)) mf.set(mfMz, c->master->zebraval);
+
+    for(int i=0; i<3; i++) if(mf.want(mfH0+i)) mf.set(mfH0+i, getHemisphere(c, i));
+    if(mf.want(mfEx) || mf.want(mfEy) || mf.want(mfEz)) {
       auto co = euc2_coordinates(c);
       int x = co.first, y = co.second;
-      ep.extra_params["ex"] = x;
-      ep.extra_params["ey"] = y;
-      if(S7 == 6) ep.extra_params["ez"] = -x-y;
+      if(mf.want(mfEx)) mf.set(mfEx, x);
+      if(mf.want(mfEy)) mf.set(mfEy, y);
+      if(mf.want(mfEz)) mf.set(mfEz, -x-y);
       }
-    if(cryst) {
+    bool want_crystal = false;
+    for(int i=0; i<crystal::MAXDIM; i++) want_crystal |= mf.want(mfCrystal+i);
+    if(want_crystal) {
       crystal::ldcoord co = crystal::get_ldcoord(c);
       for(int i=0; i<crystal::MAXDIM; i++)
-        ep.extra_params["x"+its(i)] = co[i];
+        if(mf.want(mfCrystal+i)) mf.set(mfCrystal+i, co[i]);
       }
-    if(asonov::in()) {
+    if(mf.want(mfAx) || mf.want(mfAy) || mf.want(mfAz)) {
       auto co = asonov::get_coord(c->master);
-      ep.extra_params["ax"] = szgmod(co[0], asonov::period_xy);
-      ep.extra_params["ay"] = szgmod(co[1], asonov::period_xy);
-      ep.extra_params["az"] = szgmod(co[2], asonov::period_z);      
+      if(mf.want(mfAx)) mf.set(mfAx, szgmod(co[0], asonov::period_xy));
+      if(mf.want(mfAy)) mf.set(mfAy, szgmod(co[1], asonov::period_xy));
+      if(mf.want(mfAz)) mf.set(mfAz, szgmod(co[2], asonov::period_z));
       }
-    if(nil) {
+    if(mf.want(mfNx) || mf.want(mfNy) || mf.want(mfNz)) {
       auto co = nilv::get_coord(c->master);
-      ep.extra_params["nx"] = szgmod(co[0], nilv::nilperiod[0]);
-      ep.extra_params["ny"] = szgmod(co[1], nilv::nilperiod[1]);
-      ep.extra_params["nz"] = szgmod(co[2], nilv::nilperiod[2]);      
+      if(mf.want(mfNx)) mf.set(mfNx, szgmod(co[0], nilv::nilperiod[0]));
+      if(mf.want(mfNy)) mf.set(mfNy, szgmod(co[1], nilv::nilperiod[1]));
+      if(mf.want(mfNz)) mf.set(mfNz, szgmod(co[2], nilv::nilperiod[2]));
       }
-    if(hybri)
-      ep.extra_params["level"] = hybrid::get_where(c).second;
+    if(mf.want(mfLevel))
+      mf.set(mfLevel, hybrid::get_where(c).second);
 
-    if(geometry_supports_cdata()) {
-      ep.extra_params["d0"] = getCdata(c, 0);
-      ep.extra_params["d1"] = getCdata(c, 1);
-      ep.extra_params["d2"] = getCdata(c, 2);
-      ep.extra_params["d3"] = getCdata(c, 3);
-      }
-        
-    ep.s = formula;
+    for(int i=0; i<4; i++) if(mf.want(mfD0+i)) mf.set(mfD0+i, getCdata(c, i));
+    }
+
+  cld eval_map_function(map_function& mf, int p) {
+    if(!mf.valid) return 0;
+    if(mf.want(mfP)) mf.set(mfP, p);
     try {
-      return ep.parse();
+      return mf.prog.eval();
       }
     catch(hr_parse_exception& ex) {
       return 0;
@@ -1871,8 +2003,10 @@ EX namespace patterns {
         }
       case 'f': {
         color_t res;
+        auto& mf = get_map_function(color_formula);
+        if(mf.valid) set_map_function_variables(mf, c);
         for(int i=0; i<4; i++) {
-          ld v = real(compute_map_function(c, 1+i, color_formula));
+          ld v = real(eval_map_function(mf, 1+i));
           if(i == 3) part(res, i) = (v > 0);
           else if(v < 0) part(res, i) = 0;
           else if(v > 1) part(res, i) = 255;
@@ -2062,7 +2196,7 @@ EX namespace patterns {
           "wallif(condition, color)\n"
           );
         
-        s += XLAT("see compute_map_function in pattern2.cpp for more\n");
+        s += XLAT("see get_map_function and set_map_function_variables in pattern2.cpp for more\n");
 
         s += "\n\n" + parser_help();
 
@@ -2561,7 +2695,7 @@ EX namespace linepatterns {
   void gridlinef(const shiftmatrix& V, const hyperpoint& h1, const hyperpoint& h2, color_t col, int par) { gridlinef(V, h1, V, h2, col, par); }
 
   #define ALLCELLS(R) \
-    [] (linepattern *lp) { auto& col = lp->color; for(auto& p: current_display->all_drawn_copies) for(auto& V: p.second) { cell *c = p.first; R } }
+    [] (linepattern *lp) { auto& col = lp->color; for(auto p: current_display->all_drawn_copies) for(auto& V: p.second) { cell *c = p.first; R } }
   
   #define ATCENTER(T) \
     [] (linepattern *lp) { auto& col = lp->color; shiftmatrix V = gmatrix[cwt.at]; T}
@@ -3092,6 +3226,29 @@ int read_pattern_args() {
     PHASEFROM(2);
     patterns::innerwalls = false;
     }
+  else if(argis("-pattern-bench")) {
+    /* time getpatterninfo over the cells drawn in a frame, with and without the cache */
+    PHASEFROM(3);
+    shift(); int frames = argi();
+    start_game();
+    celllister cl(cwt.at, 10, 5000, nullptr);
+    for(auto p: {patterns::PAT_ZEBRA, patterns::PAT_PALACE}) {
+      vector<int> ids[2];
+      for(int caching: {0, 1}) {
+        dynamicval<bool> dc(patterns::patterninfo_caching, caching);
+        patterns::clear_patterninfo_cache();
+        patterns::patterninfo_hits = patterns::patterninfo_misses = 0;
+        int t = SDL_GetTicks();
+        for(int f=0; f<frames; f++) {
+          ids[caching].clear();
+          for(cell *c: cl.lst) ids[caching].push_back(patterns::getpatterninfo(c, p, 0).id);
+          }
+        int t1 = SDL_GetTicks();
+        println(hlog, "pattern ", s0 + char(p), " cache ", caching ? "on " : "off", ": ", isize(cl.lst), " cells, ", (t1-t) * 1. / frames, " ms per frame (", patterns::patterninfo_hits, " hits, ", patterns::patterninfo_misses, " misses)");
+        }
+      if(ids[0] != ids[1]) println(hlog, "pattern ", s0 + char(p), ": cached results differ");
+      }
+    }
   else if(argis("-d:line")) 
     launch_dialog(linepatterns::showMenu);
 
@@ -3108,4 +3265,6 @@ int read_pattern_args() {
 auto ah_pattern = addHook(hooks_args, 0, read_pattern_args) + addHook(hooks_clearmemory, 100, [] { patterns::computed_nearer_map.clear(); patterns::computed_furthest_map.clear(); });
 #endif
 
+auto ah_patterninfo = addHook(hooks_clearmemory, 100, patterns::clear_patterninfo_cache);
+
 }
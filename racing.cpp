@@ -40,9 +40,22 @@ struct race_cellinfo {
   int from_start, from_goal;
   };  
 
+/** track metadata, stored densely; the slot of a cell in rti is given by rti_id */
 vector<race_cellinfo> rti;
 EX vector<cell*> track;
-map<cell*, int> rti_id;
+/** the slot in rti of each cell near the track */
+cell_index<int> rti_id;
+
+#if HDR
+/** statistics of a call to generate_track */
+struct track_stats_t {
+  int search_ms, tie_ms, total_ms;
+  int track_length, cells;
+  };
+#endif
+
+/** statistics of the last call to generate_track */
+EX track_stats_t track_stats;
 
 EX int trophy[MAXPLAYER];
 
@@ -237,6 +250,12 @@ void tie_info(cell *c, int from_track, int comp) {
   rti.emplace_back(race_cellinfo{c, from_track, comp, -1, -1});
   }
 
+/** the slot of c in rti, or -1 if c is not near the track */
+EX int track_slot(cell *c) {
+  int i = rti_id.index_of(c);
+  return i < 0 ? -1 : rti_id.at_index(i).second;
+  }
+
 race_cellinfo& get_info(cell *c) {
   return rti[rti_id.at(c)];
   }
@@ -256,7 +275,7 @@ void find_track(cell *start, int sign, int len) {
   dl = (8 + dl) / 2;
   if(WDIM == 3 && dl < 6) dl = 6;
   cell *goal;
-  map<cell*, cell*> parent;
+  cell_index<cell*> parent;
   map<int, vector<cell*> > cellbydist;
   cellbydist[0].push_back(start);
     
@@ -436,6 +455,7 @@ EX void generate_track() {
   #endif
 
   track.clear();
+  int t0 = SDL_GetTicks();
 
   /*
   int t = -1;
@@ -515,6 +535,8 @@ EX void generate_track() {
     return;
     }  
   
+  int t1 = SDL_GetTicks();
+
   if(WDIM == 3) dl = 7 - TWIDTH;
   for(cell *c:track) setdist(c, dl, NULL);
   
@@ -531,7 +553,7 @@ EX void generate_track() {
     for(int i=0; i<isize(cl.lst); i++) {
       cell *c = cl.lst[i];
       auto p = get_info(c);
-      forCellEx(c2, c) if(!rti_id.count(c2)) {
+      forCellEx(c2, c) if(track_slot(c2) < 0) {
         tie_info(c2, p.from_track+1, p.completion);
         cl.add(c2);
         }
@@ -560,6 +582,8 @@ EX void generate_track() {
       }
     }
   
+  int t2 = SDL_GetTicks();
+
   int byat[65536];
   for(int a=0; a<16; a++) byat[a] = 0;
   for(const auto s: rti) byat[s.from_track]++;
@@ -594,7 +618,8 @@ EX void generate_track() {
     hyperpoint h = straight * parabolic1(a) * C0;
     cell *at = s;
     virtualRebase(at, h);
-    if(!rti_id.count(at) || get_info(at).from_track >= TWIDTH) break;
+    int id = track_slot(at);
+    if(id < 0 || rti[id].from_track >= TWIDTH) break;
     }
   
   if(WDIM == 2 && !bounded_track) for(ld cleaner=0; cleaner<a*.75; cleaner += .2) for(int dir=-1; dir<=1; dir+=2) {
@@ -726,6 +751,13 @@ EX void generate_track() {
     }
   */
 
+  track_stats.search_ms = t1 - t0;
+  track_stats.tie_ms = t2 - t1;
+  track_stats.total_ms = SDL_GetTicks() - t0;
+  track_stats.track_length = isize(track);
+  track_stats.cells = isize(rti);
+  DEBB(DF_INIT, ("track generated: length ", track_stats.track_length, ", ", track_stats.cells, " cells, ", track_stats.total_ms, " ms (search ", track_stats.search_ms, " ms, metadata ", track_stats.tie_ms, " ms)"));
+
   track_ready = true;
   race_checksum = hrand(1000000);
   
@@ -764,7 +796,7 @@ EX bool set_view() {
     ld alpha = -atan2(T * C0);
     ld distance = hdist0(T * C0);
     ld beta = -atan2(xpush(-distance) * spin(-alpha) * T * Cx1);
-    current_history[multi::cpid].emplace_back(ghostmoment{ticks - race_start_tick, rti_id[who->base], 
+    current_history[multi::cpid].emplace_back(ghostmoment{ticks - race_start_tick, max(track_slot(who->base), 0), 
       angle_to_uchar(alpha),
       frac_to_uchar(distance / distance_multiplier),
       angle_to_uchar(beta),
@@ -824,6 +856,35 @@ int readArgs() {
     start_game();
     race_start_tick = 1;
     }
+  else if(argis("-race-bench")) {
+    /* generate tracks in several geometries, and time the per-cell lookups done while racing */
+    PHASEFROM(2);
+    shift(); int rounds = argi();
+    vector<eGeometry> geos = {gNormal, gEuclidSquare};
+    #if MAXMDIM >= 4
+    geos.push_back(gBinary3);
+    #endif
+    for(eGeometry g: geos) {
+      stop_game();
+      set_geometry(g);
+      if(!racing::on) switch_game_mode(rg::racing);
+      race_try = 0;
+      int t = SDL_GetTicks();
+      start_game();
+      int t1 = SDL_GetTicks();
+      if(!track_ready) { println(hlog, ginf[g].tiling_name, ": no track"); continue; }
+      map<cell*, int> by_map;
+      for(int i=0; i<isize(rti); i++) by_map[rti[i].c] = i;
+      long long total[2] = {0, 0};
+      int t2 = SDL_GetTicks();
+      for(int r=0; r<rounds; r++) for(auto& ri: rti) total[0] += min(rti[by_map.at(ri.c)].completion * 100 / (isize(track) - DROP), 100);
+      int t3 = SDL_GetTicks();
+      for(int r=0; r<rounds; r++) for(auto& ri: rti) total[1] += get_percentage(ri.c);
+      int t4 = SDL_GetTicks();
+      println(hlog, ginf[g].tiling_name, ": track length ", isize(track), ", ", isize(rti), " cells, ", race_try, " retries, start_game ", t1-t, " ms (search ", track_stats.search_ms, " ms, metadata ", track_stats.tie_ms, " ms)");
+      println(hlog, "  ", rounds, " x ", isize(rti), " percentage queries: map ", t3-t2, " ms, slots ", t4-t3, " ms", total[0] == total[1] ? "" : " (results differ)");
+      }
+    }
   else return 1;
   return 0;
   }
@@ -1360,8 +1421,13 @@ shiftmatrix racerel(ld rel) {
   return shiftless(atscreenpos(bsize, vid.yres - bsize - rel * (vid.yres - bsize*2) / 100, bsize) * spin(M_PI/2));
   }
 
+/** the percentage of the track completed at the given slot of rti */
+EX int get_percentage_at(int id) {
+  return min(rti[id].completion * 100 / (isize(track) - DROP), 100);
+  }
+
 EX int get_percentage(cell *c) {
-  return min(get_info(c).completion * 100 / (isize(track) - DROP), 100);
+  return get_percentage_at(rti_id.at(c));
   }
   
 EX int get_percentage(int i) {
@@ -1372,7 +1438,7 @@ void draw_ghost_state(ghost& ghost) {
   auto& p = get_ghostmoment(ghost);
   if(p.where_id >= isize(rti)) return;
   cell *w = rti[p.where_id].c;
-  ld result = ghost_finished(ghost) ? 100 : get_percentage(w);
+  ld result = ghost_finished(ghost) ? 100 : get_percentage_at(p.where_id);
   draw_ghost_at(ghost, w, racerel(result), p);
   }
 
@@ -1450,7 +1516,7 @@ EX void markers() {
   }
 
 EX void add_debug(cell *c) { 
-  if(racing::on && racing::rti_id[c]) {
+  if(racing::on && racing::track_slot(c) >= 0) {
     auto& r = racing::get_info(c);
     dialog::addSelItem("from_track", its(r.from_track), 0);
     dialog::addSelItem("from_start", its(r.from_start), 0);
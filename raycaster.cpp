@@ -155,7 +155,10 @@ raycaster::raycaster(string vsh, string fsh) : GLprogram(vsh, fsh) {
 
 shared_ptr<raycaster> our_raycaster;
 
-EX void reset_raycaster() { our_raycaster = nullptr; }
+/** increased whenever our_raycaster is reset */
+int raycaster_generation;
+
+EX void reset_raycaster() { our_raycaster = nullptr; raycaster_generation++; }
 
 int deg, irays;
 
@@ -187,12 +190,8 @@ string build_getter(string type, string name, int index) {
 EX hookset<void(string&, string&)> hooks_rayshader;
 EX hookset<bool(shared_ptr<raycaster>)> hooks_rayset;
 
-void enable_raycaster() {
-  using glhr::to_glsl;
-  if(geometry != last_geometry) {
-    reset_raycaster();
-    }
-  
+/** compute deg, the number of texture entries per cell */
+void compute_deg() {
   wall_offset(centerover); /* so raywall is not empty and deg is not zero */
 
   deg = 0;
@@ -200,6 +199,15 @@ void enable_raycaster() {
   auto samples = hybrid::gen_sample_list();
   for(int i=0; i<isize(samples)-1; i++)
     deg = max(deg, samples[i+1].first - samples[i].first);
+  }
+
+void enable_raycaster() {
+  using glhr::to_glsl;
+  if(geometry != last_geometry) {
+    reset_raycaster();
+    }
+  
+  compute_deg();
   
   last_geometry = geometry;
   if(!our_raycaster) { 
@@ -1112,7 +1120,8 @@ void enable_raycaster() {
 
 int length, per_row, rows;
 
-void bind_array(vector<array<float, 4>>& v, GLint t, GLuint& tx, int id) {
+/** upload v to the texture tx; if dirty is given, only the rows marked there are uploaded */
+void bind_array(vector<array<float, 4>>& v, GLint t, GLuint& tx, int id, const vector<char> *dirty = nullptr) {
   if(t == -1) println(hlog, "bind to nothing");
   glUniform1i(t, id);
 
@@ -1124,7 +1133,14 @@ void bind_array(vector<array<float, 4>>& v, GLint t, GLuint& tx, int id) {
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   
-  glTexImage2D(GL_TEXTURE_2D, 0, 0x8814 /* GL_RGBA32F */, length, isize(v)/length, 0, GL_RGBA, GL_FLOAT, &v[0]);  
+  if(!dirty)
+    glTexImage2D(GL_TEXTURE_2D, 0, 0x8814 /* GL_RGBA32F */, length, isize(v)/length, 0, GL_RGBA, GL_FLOAT, &v[0]);  
+  else for(int r=0; r<isize(*dirty); r++) if((*dirty)[r]) {
+    int r1 = r;
+    while(r1 < isize(*dirty) && (*dirty)[r1]) r1++;
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, r, length, r1-r, GL_RGBA, GL_FLOAT, &v[r*length]);
+    r = r1;
+    }
   GLERR("bind_array");
   }
 
@@ -1171,7 +1187,313 @@ transmatrix get_ms(cell *c, int a, bool mirror) {
     }
   }
 
+/** should the cell data be kept between frames (see cell_buffers) */
+EX bool incremental = true;
+
+/** statistics of the last frame: the cells in range, the cells encoded again, and the texture rows uploaded */
+EX int stat_cells, stat_encoded, stat_rows;
+
+/** \brief the cell data of the raycaster, kept between the frames
+ *
+ *  Every cell in range has a slot in the textures. A cell keeps its slot while it
+ *  stays in range, and only the cells which are new, changed (according to
+ *  signature), or adjacent to a new, removed or changed cell are encoded again;
+ *  only the rows of the textures containing them are uploaded.
+ */
+struct cell_buffers {
+  int rows;
+  /** the cell in each slot, or nullptr if the slot is free */
+  vector<cell*> cells;
+  /** the signature of the cell in each slot, when it was last encoded */
+  vector<unsigned> signatures;
+  /** the slot of each cell in range, in this frame and in the previous one */
+  cell_index<int> slot_of, old_slot_of;
+  vector<int> free_slots;
+  vector<array<float, 4>> connections, wallcolor, texturemap, volumetric;
+  /** the matrices from the sample list, and the ones added while encoding */
+  vector<transmatrix> base_ms, extra_ms;
+  /** the rows changed since the last upload */
+  vector<char> dirty_rows;
+  /** if false, everything is encoded and uploaded again */
+  bool valid;
+  /** the textures need to be uploaded in full, since everything was encoded again */
+  bool full_upload;
+  /** the state which the encoded data depends on */
+  int deletions;
+  bool volumetric_on;
+  color_t out_of_range;
+  int floors_generation, program_generation;
+  int layout_deg, layout_per_row, layout_length;
+
+  cell_buffers() : rows(0), valid(false), full_upload(true) {}
+
+  vector<transmatrix> matrices() {
+    auto ms = base_ms;
+    for(auto& T: extra_ms) ms.push_back(T);
+    return ms;
+    }
+
+  bool update(cell *cs, const vector<cell*>& lst, const vector<transmatrix>& base);
+  bool encode(cell *c, int id, vector<transmatrix>& ms);
+  };
+
+cell_buffers buffers;
+
+/** the cells in range of cs, in BFS order */
+vector<cell*> cells_in_range(cell *cs) {
+  manual_celllister cl;
+  cl.add(cs);
+  bool optimize = !isWall3(cs);
+  for(int i=0; i<isize(cl.lst); i++) {
+    cell *c = cl.lst[i];
+    if(racing::on && i > 0 && c->wall == waBarrier) continue;
+    if(optimize && isWall3(c)) continue;
+    forCellCM(c2, c) {
+      if(rays_generate) setdist(c2, 7, c);
+      cl.add(c2);
+      if(isize(cl.lst) >= max_cells) return cl.lst;
+      }
+    }
+  return cl.lst;
+  }
+
+/** the matrices from the sample list, and the mirrors around cs */
+vector<transmatrix> base_matrices(cell *cs) {
+  auto sa = hybrid::gen_sample_list();
+  
+  vector<transmatrix> ms(sa.back().first, Id);
+  
+  for(auto& p: sa) {
+    int id = p.first;
+    cell *c = p.second;
+    if(!c) continue;
+    for(int j=0; j<c->type; j++)
+      ms[id+j] = hybrid::ray_iadj(c, j);
+    if(WDIM == 2) for(int a: {0, 1}) {
+      ms[id+c->type+a] = get_ms(c, a, false);
+      }
+    }
+  
+  // println(hlog, ms);
+  
+  if(!sol && !nil && (reflect_val || reg3::ultra_mirror_in())) {
+    if(BITRUNCATED) exit(1);
+    for(int j=0; j<cs->type; j++) {
+      transmatrix T = inverse(ms[j]);
+      hyperpoint h = tC0(T);
+      ld d = hdist0(h);
+      transmatrix U = rspintox(h) * xpush(d/2) * MirrorX * xpush(-d/2) * spintox(h);
+      ms.push_back(U);
+      }
+    
+    if(WDIM == 2) 
+      for(int a: {0, 1}) {
+        ms.push_back(get_ms(cs, a, true));
+        }
+    
+    if(reg3::ultra_mirror_in()) {
+      for(auto v: cgi.ultra_mirrors) 
+        ms.push_back(v);
+      }
+    }
+  return ms;
+  }
+
+/** what the encoding of c depends on, apart from the geometry */
+unsigned signature(cell *c) {
+  celldrawer dd;
+  dd.c = c;
+  dd.setcolors();
+  unsigned h = c->wall;
+  h = h * 1000003 + c->land;
+  h = h * 1000003 + dd.wcol;
+  h = h * 1000003 + dd.fcol;
+  if(volumetric::on) {
+    auto& vmap = volumetric::vmap;
+    h = h * 1000003 + (vmap.count(c) ? vmap[c] : 1);
+    }
+  return h;
+  }
+
+bool cell_buffers::encode(cell *c, int id, vector<transmatrix>& ms) {
+  int u0 = (id/per_row*length) + (id%per_row * deg);
+  for(int i=0; i<deg; i++) 
+    connections[u0+i] = wallcolor[u0+i] = texturemap[u0+i] = volumetric[u0+i] = array<float, 4>{{0, 0, 0, 0}};
+  dirty_rows[id/per_row] = true;
+  
+  auto& vmap = volumetric::vmap;
+  if(volumetric::on) {
+    celldrawer dd;
+    dd.c = c;
+    dd.setcolors();
+    int u = (id/per_row*length) + (id%per_row * deg);
+    color_t vcolor;
+    if(vmap.count(c))
+      vcolor = vmap[c];
+    else 
+      vcolor = (backcolor << 8);
+    volumetric[u] = glhr::acolor(vcolor);
+    }
+  forCellIdEx(c1, i, c) { 
+    int u = (id/per_row*length) + (id%per_row * deg) + i;
+    int j = slot_of.index_of(c1);
+    if(j < 0) {
+      wallcolor[u] = glhr::acolor(color_out_of_range | 0xFF);
+      texturemap[u] = glhr::makevertex(0.1,0,0);
+      continue;
+      }
+    auto code = enc(slot_of.at_index(j).second, 0);
+    connections[u][0] = code[0];
+    connections[u][1] = code[1];
+    if(isWall3(c1)) {
+      celldrawer dd;
+      dd.c = c1;
+      dd.setcolors();
+      shiftmatrix Vf;
+      dd.set_land_floor(Vf);
+      color_t wcol = darkena(dd.wcol, 0, 0xFF);
+      int dv = get_darkval(c1, c->c.spin(i));
+      float p = 1 - dv / 16.;
+      wallcolor[u] = glhr::acolor(wcol);
+      for(int a: {0,1,2}) wallcolor[u][a] *= p;
+      if(qfi.fshape) {
+        texturemap[u] = floor_texture_map[qfi.fshape->id];
+        }
+      else
+        texturemap[u] = glhr::makevertex(0.1,0,0);
+      }
+    else {
+      color_t col = transcolor(c, c1, winf[c->wall].color) | transcolor(c1, c, winf[c1->wall].color);
+      if(col == 0)
+        wallcolor[u] = glhr::acolor(0);
+      else {
+        int dv = get_darkval(c1, c->c.spin(i));
+        float p = 1 - dv / 16.;
+        wallcolor[u] = glhr::acolor(col);
+        for(int a: {0,1,2}) wallcolor[u][a] *= p;
+        texturemap[u] = glhr::makevertex(0.001,0,0);
+        }
+      }
+    
+    int wo = wall_offset(c);
+    if(wo >= irays) {
+      println(hlog, "wo=", wo, " irays = ", irays);
+      return false;
+      }
+    transmatrix T = currentmap->iadj(c, i) * inverse(ms[wo + i]);
+    for(int k=0; k<=isize(ms); k++) {
+      if(k < isize(ms) && !eqmatrix(ms[k], T)) continue;
+      if(k == isize(ms)) ms.push_back(T);
+      connections[u][2] = (k+.5) / 1024.;
+      break;
+      }
+    connections[u][3] = (wall_offset(c1) / 256.) + (c1->type + (WDIM == 2 ? 2 : 0) + .5) / 4096.;
+    }
+  if(WDIM == 2) for(int a: {0, 1}) {
+    celldrawer dd;
+    dd.c = c;
+    dd.setcolors();
+    shiftmatrix Vf;
+    dd.set_land_floor(Vf);
+    int u = (id/per_row*length) + (id%per_row * deg) + c->type + a;
+    wallcolor[u] = glhr::acolor(darkena(dd.fcol, 0, 0xFF));
+    if(qfi.fshape) 
+      texturemap[u] = floor_texture_map[qfi.fshape->id];
+    else
+      texturemap[u] = glhr::makevertex(0.1,0,0);
+    }
+  return true;
+  }
+
+/** bring the buffers up to date for the cells lst around cs; false if the raycaster needs to be reset */
+bool cell_buffers::update(cell *cs, const vector<cell*>& lst, const vector<transmatrix>& base) {
+  PROFILE_ZONE("ray cells");
+  int need_rows = next_p2((isize(lst)+per_row-1) / per_row);
+
+  bool same_base = valid && isize(base) == isize(base_ms);
+  if(same_base) for(int i=0; i<isize(base); i++) if(!eqmatrix(base[i], base_ms[i])) { same_base = false; break; }
+
+  if(!incremental || !same_base || need_rows > rows || deletions != cell_deletions || volumetric_on != volumetric::on || out_of_range != color_out_of_range)
+    valid = false;
+  if(floors_generation != floor_textures_generation || program_generation != raycaster_generation)
+    valid = false;
+  if(layout_deg != deg || layout_per_row != per_row || layout_length != length)
+    valid = false;
+
+  bool full = !valid;
+  if(full) {
+    rows = need_rows;
+    cells.clear(); signatures.clear(); free_slots.clear(); slot_of.clear(); extra_ms.clear();
+    base_ms = base;
+    deletions = cell_deletions; volumetric_on = volumetric::on; out_of_range = color_out_of_range;
+    floors_generation = floor_textures_generation; program_generation = raycaster_generation;
+    layout_deg = deg; layout_per_row = per_row; layout_length = length;
+    for(auto v: {&connections, &wallcolor, &texturemap, &volumetric}) v->assign(length * rows, array<float, 4>{{0, 0, 0, 0}});
+    dirty_rows.assign(rows, true);
+    full_upload = true;
+    }
+  ray::rows = rows;
+
+  /* reassign the slots */
+  swap(slot_of, old_slot_of);
+  slot_of.clear();
+  vector<cell*> added, touched;
+  for(cell *c: lst) {
+    int i = old_slot_of.index_of(c);
+    if(i >= 0) slot_of[c] = old_slot_of.at_index(i).second;
+    else added.push_back(c);
+    }
+  for(int s=0; s<isize(cells); s++) if(cells[s] && !slot_of.count(cells[s])) {
+    forCellEx(c2, cells[s]) touched.push_back(c2);
+    cells[s] = nullptr;
+    free_slots.push_back(s);
+    }
+  sort(free_slots.begin(), free_slots.end(), [] (int a, int b) { return a > b; });
+  for(cell *c: added) {
+    int s;
+    if(free_slots.empty()) s = isize(cells), cells.push_back(nullptr), signatures.push_back(0);
+    else s = free_slots.back(), free_slots.pop_back();
+    if(s >= rows * per_row) { valid = false; return update(cs, lst, base); }
+    cells[s] = c;
+    slot_of[c] = s;
+    }
+
+  /* find the slots to encode again */
+  vector<char> redo(isize(cells), full);
+  auto mark = [&] (cell *c) {
+    int i = slot_of.index_of(c);
+    if(i >= 0) redo[slot_of.at_index(i).second] = true;
+    };
+  for(cell *c: touched) mark(c);
+  for(cell *c: added) { mark(c); forCellEx(c2, c) mark(c2); }
+  for(cell *c: lst) {
+    int s = slot_of.at(c);
+    unsigned sig = signature(c);
+    if(sig != signatures[s]) {
+      signatures[s] = sig;
+      mark(c); forCellEx(c2, c) mark(c2);
+      }
+    }
+
+  auto ms = matrices();
+  stat_cells = isize(lst);
+  stat_encoded = 0;
+  for(cell *c: lst) {
+    int s = slot_of.at(c);
+    if(!redo[s]) continue;
+    stat_encoded++;
+    if(!encode(c, s, ms)) { valid = false; return false; }
+    }
+
+  /* matrices found in the earlier frames may be no longer used, so try again from scratch */
+  if(isize(ms) > gms_limit && !full) { valid = false; return update(cs, lst, base); }
+  extra_ms.assign(ms.begin() + isize(base_ms), ms.end());
+  valid = true;
+  return true;
+  }
+
 EX void cast() {
+  PROFILE_ZONE("ray::cast");
   if(isize(cgi.raywall) > irays) reset_raycaster();
   enable_raycaster();
   
@@ -1209,8 +1531,6 @@ EX void cast() {
   length = 4096;
   per_row = length / deg;
   
-  vector<cell*> lst;
-
   cell *cs = centerover;
 
   transmatrix T = cview().T;
@@ -1236,36 +1556,21 @@ EX void cast() {
       goto back;
       }
   
-  if(true) {
-    manual_celllister cl;
-    cl.add(cs);
-    bool optimize = !isWall3(cs);
-    for(int i=0; i<isize(cl.lst); i++) {
-      cell *c = cl.lst[i];
-      if(racing::on && i > 0 && c->wall == waBarrier) continue;
-      if(optimize && isWall3(c)) continue;
-      forCellCM(c2, c) {
-        if(rays_generate) setdist(c2, 7, c);
-        cl.add(c2);
-        if(isize(cl.lst) >= max_cells) goto finish;
-        }
-      }
-    finish:
-    lst = cl.lst;
+  vector<cell*> lst = cells_in_range(cs);
+
+  auto& b = buffers;
+  if(!b.update(cs, lst, base_matrices(cs))) {
+    reset_raycaster();
+    return;
     }
   
-  rows = next_p2((isize(lst)+per_row-1) / per_row);
-  
-  map<cell*, int> ids;
-  for(int i=0; i<isize(lst); i++) ids[lst[i]] = i;
-
   glUniform1i(o->uLength, length);
   GLERR("uniform mediump length");
   
   glUniformMatrix4fv(o->uStart, 1, 0, glhr::tmtogl_transpose3(T).as_array());
   if(o->uLP != -1) glUniformMatrix4fv(o->uLP, 1, 0, glhr::tmtogl_transpose3(inverse(NLP)).as_array());
   GLERR("uniform mediump start");
-  uniform2(o->uStartid, enc(ids[cs], 0));
+  uniform2(o->uStartid, enc(b.slot_of.at(cs), 0));
   GLERR("uniform mediump startid");
   glUniform1f(o->uIPD, vid.ipd);
   GLERR("uniform mediump IPD");
@@ -1275,136 +1580,10 @@ EX void cast() {
     glUniform1i(o->uSides, cs->type + (WDIM == 2 ? 2 : 0));
     }
 
-  auto sa = hybrid::gen_sample_list();
-  
-  vector<transmatrix> ms(sa.back().first, Id);
-  
-  for(auto& p: sa) {
-    int id = p.first;
-    cell *c = p.second;
-    if(!c) continue;
-    for(int j=0; j<c->type; j++)
-      ms[id+j] = hybrid::ray_iadj(c, j);
-    if(WDIM == 2) for(int a: {0, 1}) {
-      ms[id+c->type+a] = get_ms(c, a, false);
-      }
-    }
-  
-  // println(hlog, ms);
-  
-  if(!sol && !nil && (reflect_val || reg3::ultra_mirror_in())) {
-    if(BITRUNCATED) exit(1);
-    for(int j=0; j<cs->type; j++) {
-      transmatrix T = inverse(ms[j]);
-      hyperpoint h = tC0(T);
-      ld d = hdist0(h);
-      transmatrix U = rspintox(h) * xpush(d/2) * MirrorX * xpush(-d/2) * spintox(h);
-      ms.push_back(U);
-      }
-    
-    if(WDIM == 2) 
-      for(int a: {0, 1}) {
-        ms.push_back(get_ms(cs, a, true));
-        }
-    
-    if(reg3::ultra_mirror_in()) {
-      for(auto v: cgi.ultra_mirrors) 
-        ms.push_back(v);
-      }
-    }
-  
-  vector<array<float, 4>> connections(length * rows);
-  vector<array<float, 4>> wallcolor(length * rows);
-  vector<array<float, 4>> texturemap(length * rows);
-  vector<array<float, 4>> volumetric(length * rows);
-  
-  if(1) for(cell *c: lst) {
-    int id = ids[c];
-    auto& vmap = volumetric::vmap;
-    if(volumetric::on) {
-      celldrawer dd;
-      dd.c = c;
-      dd.setcolors();
-      int u = (id/per_row*length) + (id%per_row * deg);
-      color_t vcolor;
-      if(vmap.count(c))
-        vcolor = vmap[c];
-      else 
-        vcolor = (backcolor << 8);
-      volumetric[u] = glhr::acolor(vcolor);
-      }
-    forCellIdEx(c1, i, c) { 
-      int u = (id/per_row*length) + (id%per_row * deg) + i;
-      if(!ids.count(c1)) {
-        wallcolor[u] = glhr::acolor(color_out_of_range | 0xFF);
-        texturemap[u] = glhr::makevertex(0.1,0,0);
-        continue;
-        }
-      auto code = enc(ids[c1], 0);
-      connections[u][0] = code[0];
-      connections[u][1] = code[1];
-      if(isWall3(c1)) {
-        celldrawer dd;
-        dd.c = c1;
-        dd.setcolors();
-        shiftmatrix Vf;
-        dd.set_land_floor(Vf);
-        color_t wcol = darkena(dd.wcol, 0, 0xFF);
-        int dv = get_darkval(c1, c->c.spin(i));
-        float p = 1 - dv / 16.;
-        wallcolor[u] = glhr::acolor(wcol);
-        for(int a: {0,1,2}) wallcolor[u][a] *= p;
-        if(qfi.fshape) {
-          texturemap[u] = floor_texture_map[qfi.fshape->id];
-          }
-        else
-          texturemap[u] = glhr::makevertex(0.1,0,0);
-        }
-      else {
-        color_t col = transcolor(c, c1, winf[c->wall].color) | transcolor(c1, c, winf[c1->wall].color);
-        if(col == 0)
-          wallcolor[u] = glhr::acolor(0);
-        else {
-          int dv = get_darkval(c1, c->c.spin(i));
-          float p = 1 - dv / 16.;
-          wallcolor[u] = glhr::acolor(col);
-          for(int a: {0,1,2}) wallcolor[u][a] *= p;
-          texturemap[u] = glhr::makevertex(0.001,0,0);
-          }
-        }
-      
-      int wo = wall_offset(c);
-      if(wo >= irays) {
-        println(hlog, "wo=", wo, " irays = ", irays);
-        reset_raycaster();
-        return;
-        }
-      transmatrix T = currentmap->iadj(c, i) * inverse(ms[wo + i]);
-      for(int k=0; k<=isize(ms); k++) {
-        if(k < isize(ms) && !eqmatrix(ms[k], T)) continue;
-        if(k == isize(ms)) ms.push_back(T);
-        connections[u][2] = (k+.5) / 1024.;
-        break;
-        }
-      connections[u][3] = (wall_offset(c1) / 256.) + (c1->type + (WDIM == 2 ? 2 : 0) + .5) / 4096.;
-      }
-    if(WDIM == 2) for(int a: {0, 1}) {
-      celldrawer dd;
-      dd.c = c;
-      dd.setcolors();
-      shiftmatrix Vf;
-      dd.set_land_floor(Vf);
-      int u = (id/per_row*length) + (id%per_row * deg) + c->type + a;
-      wallcolor[u] = glhr::acolor(darkena(dd.fcol, 0, 0xFF));
-      if(qfi.fshape) 
-        texturemap[u] = floor_texture_map[qfi.fshape->id];
-      else
-        texturemap[u] = glhr::makevertex(0.1,0,0);
-      }
-    }
+  auto ms = b.matrices();
   
   if(prod) {
-    for(auto p: sa) {
+    for(auto p: hybrid::gen_sample_list()) {
       int id =p.first;
       if(id == 0) continue;
       ms[id-2] = Id;
@@ -1456,10 +1635,15 @@ EX void cast() {
   glUniformMatrix4fv(o->uM, isize(gms), 0, gms[0].as_array());
   gms_size = isize(gms);
   
-  bind_array(wallcolor, o->tWallcolor, txWallcolor, 4);
-  bind_array(connections, o->tConnections, txConnections, 3);
-  bind_array(texturemap, o->tTextureMap, txTextureMap, 5);
-  if(volumetric::on) bind_array(volumetric, o->tVolumetric, txVolumetric, 6);
+  bool full_upload = b.full_upload;
+  b.full_upload = false;
+  auto dirty = full_upload ? nullptr : &b.dirty_rows;
+  bind_array(b.wallcolor, o->tWallcolor, txWallcolor, 4, dirty);
+  bind_array(b.connections, o->tConnections, txConnections, 3, dirty);
+  bind_array(b.texturemap, o->tTextureMap, txTextureMap, 5, dirty);
+  if(volumetric::on) bind_array(b.volumetric, o->tVolumetric, txVolumetric, 6, dirty);
+  stat_rows = 0;
+  for(auto& r: b.dirty_rows) { if(r || full_upload) stat_rows++; r = false; }
   
   auto cols = glhr::acolor(darkena(backcolor, 0, 0xFF));
   if(o->uFogColor != -1)
@@ -1483,6 +1667,81 @@ EX void cast() {
   GLERR("finish");
   }
 
+/** the number of entries in which a and b differ, for the cells in lst (the slots may differ) */
+int compare_buffers(cell_buffers& a, cell_buffers& b, const vector<cell*>& lst) {
+  int diffs = 0;
+  auto ma = a.matrices(), mb = b.matrices();
+  auto decode = [] (cell_buffers& x, const array<float, 4>& v) -> cell* {
+    int s = int(v[1] * x.rows) * per_row + int(v[0] * length) / deg;
+    return s < isize(x.cells) ? x.cells[s] : nullptr;
+    };
+  for(cell *c: lst) {
+    int ua = a.slot_of.at(c), ub = b.slot_of.at(c);
+    ua = (ua/per_row*length) + (ua%per_row * deg);
+    ub = (ub/per_row*length) + (ub%per_row * deg);
+    for(int i=0; i<deg; i++) {
+      if(a.wallcolor[ua+i] != b.wallcolor[ub+i] || a.texturemap[ua+i] != b.texturemap[ub+i] || a.volumetric[ua+i] != b.volumetric[ub+i]) { diffs++; continue; }
+      auto& ca = a.connections[ua+i];
+      auto& cb = b.connections[ub+i];
+      if(i >= c->type || !a.slot_of.count(c->move(i))) { if(ca != cb) diffs++; continue; }
+      if(decode(a, ca) != decode(b, cb) || ca[3] != cb[3] || !eqmatrix(ma[int(ca[2] * 1024)], mb[int(cb[2] * 1024)])) diffs++;
+      }
+    }
+  return diffs;
+  }
+
+/** encode the cells along a random walk, with and without keeping the buffers; no GL needed */
+EX void bench(int frames) {
+  cgi.require_shapes();
+  length = 4096;
+  compute_deg();
+  per_row = length / deg;
+  int q = isize(cgi.all_escher_floorshapes) + isize(cgi.all_plain_floorshapes);
+  if(isize(floor_texture_map) < q) floor_texture_map.resize(q);
+
+  vector<cell*> path;
+  cell *c = centerover;
+  shrand(1);
+  for(int f=0; f<frames; f++) {
+    /* move to the next cell every 4 frames */
+    if(f % 4 == 3) c = c->cmove(hrand(c->type));
+    path.push_back(c);
+    }
+
+  vector<vector<cell*>> lsts;
+  for(cell *c: path) lsts.push_back(cells_in_range(c));
+  /* the wall offsets of all the cells are known now, as they would be after reset_raycaster */
+  for(auto& lst: lsts) for(cell *c: lst) forCellEx(c1, c) wall_offset(c1);
+  dynamicval<int> di(irays, isize(cgi.raywall));
+  vector<vector<transmatrix>> bases;
+  for(cell *c: path) bases.push_back(base_matrices(c));
+
+  for(bool inc: {false, true}) {
+    dynamicval<bool> dinc(incremental, inc);
+    cell_buffers b;
+    long long encoded = 0, rows = 0;
+    int t = SDL_GetTicks();
+    for(int f=0; f<frames; f++) {
+      b.update(path[f], lsts[f], bases[f]);
+      encoded += stat_encoded;
+      for(auto& r: b.dirty_rows) { if(r) rows++; r = false; }
+      }
+    int t1 = SDL_GetTicks();
+    println(hlog, inc ? "incremental: " : "full:        ", (t1-t) * 1. / frames, " ms per frame, ", encoded * 1. / frames, " of ", isize(lsts.back()), " cells and ", rows * 1. / frames, " rows per frame");
+    }
+
+  cell_buffers b;
+  int diffs = 0;
+  for(int f=0; f<frames; f++) {
+    b.update(path[f], lsts[f], bases[f]);
+    cell_buffers ref;
+    dynamicval<bool> dinc(incremental, false);
+    ref.update(path[f], lsts[f], bases[f]);
+    diffs += compare_buffers(b, ref, lsts[f]);
+    }
+  println(hlog, "differences from the full encoding: ", diffs);
+  }
+
 EX namespace volumetric {
 
 EX bool on;
@@ -1649,6 +1908,10 @@ EX void configure() {
       };
     });
   
+  dialog::addBoolItem_action(XLAT("keep the cell data between frames"), incremental, 'I');
+  if(ray::in_use)
+    dialog::addInfo(its(stat_encoded) + "/" + its(stat_cells) + " cells encoded, " + its(stat_rows) + " rows uploaded");
+
   if(gms_size > gms_limit && ray::in_use) {
     dialog::addBreak(100);
     dialog::addHelp(XLAT("unfortunately this honeycomb is too complex for the current implementation (%1>%2)", its(gms_size), its(gms_limit)));
@@ -1712,6 +1975,14 @@ int readArgs() {
     PHASEFROM(2); 
     shift_arg_formula(reflect_val, reset_raycaster);
     }
+  else if(argis("-ray-incremental")) {
+    PHASEFROM(2); shift(); incremental = argi();
+    }
+  else if(argis("-ray-bench")) {
+    PHASEFROM(3); shift(); int frames = argi();
+    start_game();
+    bench(frames);
+    }
   else if(argis("-ray-cells-no")) {
     PHASEFROM(2); shift();
     rays_generate = false;
@@ -1749,6 +2020,7 @@ void addconfig() {
   addsaver(max_iter_sol, "ray_max_iter_sol");
   addsaver(max_cells, "ray_max_cells");
   addsaver(rays_generate, "ray_generate");
+  addsaver(incremental, "ray_incremental");
   }
 auto hookc = addHook(hooks_configfile, 100, addconfig);
 #endif
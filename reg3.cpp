@@ -25,6 +25,21 @@ EX namespace reg3 {
 
   #if HDR
   inline short& altdist(heptagon *h) { return h->emeraldval; }
+
+  /** \brief a read-only view of a rule table, which lives either in a vector or in a memory-mapped rule file */
+  template<class T> struct rule_array {
+    const T *ptr;
+    int n;
+    rule_array() : ptr(nullptr), n(0) {}
+    template<class C> void set(const C& v) { ptr = v.data(); n = isize(v); }
+    const T& operator [] (int i) const { return ptr[i]; }
+    int size() const { return n; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + n; }
+    };
+
+  /** \brief uncompressed rule files start with this magic; they can be used in place */
+  static const char raw_rule_magic[9] = "HRRULES1";
   #endif
   
   EX int extra_verification;
@@ -924,100 +939,245 @@ EX namespace reg3 {
 
     fieldpattern::fpattern fp;
 
-    vector<int> root;
-    string other;
-    vector<short> children;
+    rule_array<int> root;
+    rule_array<char> other;
+    rule_array<short> children;
     
     vector<int> otherpos;
-    
-    void load_ruleset(string fname) {
+
+    /** storage for the tables if they could not be used in place */
+    vector<int> root_data;
+    vector<short> children_data;
+    string other_data;
+
+    /** contents of the rule file, if it is not memory-mapped */
+    string file_data;
+
+    #if CAP_MMAP
+    void *mapped = nullptr;
+    size_t mapped_size = 0;
+    #endif
+
+    /** get the whole contents of the rule file, of any size; mmap it if possible */
+    pair<const char*, size_t> open_ruleset(const string& fname) {
+      #if CAP_MMAP
+      int fd = open(fname.c_str(), O_RDONLY);
+      if(fd >= 0) {
+        struct stat st;
+        if(fstat(fd, &st) == 0 && st.st_size > 0) {
+          void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+          if(p != MAP_FAILED) {
+            close(fd);
+            mapped = p; mapped_size = st.st_size;
+            return {(const char*) p, mapped_size};
+            }
+          }
+        close(fd);
+        }
+      #endif
       FILE *f = fopen(fname.c_str(), "rb");
-      if(!f) f = fopen((rsrcdir + fname).c_str(), "rb");
-      string buf;
-      buf.resize(1000000);
-      int qty = fread(&buf[0], 1, 1000000, f);
-      buf.resize(qty);
+      if(!f) return {nullptr, 0};
+      file_data.clear();
+      char buf[1<<16];
+      while(true) {
+        size_t qty = fread(buf, 1, sizeof(buf), f);
+        file_data.append(buf, qty);
+        if(qty < sizeof(buf)) break;
+        }
+      fclose(f);
+      return {file_data.data(), file_data.size()};
+      }
+
+    void close_ruleset() {
+      #if CAP_MMAP
+      if(mapped) munmap(mapped, mapped_size);
+      mapped = nullptr; mapped_size = 0;
+      #endif
+      string().swap(file_data);
+      }
 
-      shstream ins(decompress_string(buf));
+    /** the uncompressed format: magic, four int32 lengths (fieldpattern data, root, children, other), 
+     *  fieldpattern data padded to 4 bytes, then the tables as raw arrays */
+    bool load_raw_ruleset(const char *data, size_t len) {
+      const size_t header = 8 + 4 * sizeof(int32_t);
+      if(len < header || memcmp(data, raw_rule_magic, 8)) return false;
+      int32_t q[4];
+      memcpy(q, data + 8, sizeof(q));
+      size_t fp_len = q[0], root_at = header + ((fp_len + 3) & ~3);
+      size_t children_at = root_at + sizeof(int) * q[1];
+      size_t other_at = children_at + sizeof(short) * q[2];
+      if(q[0] < 0 || q[1] < 0 || q[2] < 0 || q[3] < 0 || other_at + q[3] > len) throw hstream_exception();
+      shstream ins(string(data + header, fp_len));
+      hread_fpattern(ins, fp);
+      root.ptr = (const int*) (data + root_at); root.n = q[1];
+      children.ptr = (const short*) (data + children_at); children.n = q[2];
+      other.ptr = data + other_at; other.n = q[3];
+      return true;
+      }
+
+    void load_ruleset(string fname) {
+      auto p = open_ruleset(fname);
+      if(!p.first) p = open_ruleset(rsrcdir + fname);
+      if(!p.first) { println(hlog, "rule file not found: ", fname); throw hstream_exception(); }
+
+      if(load_raw_ruleset(p.first, p.second)) return;
+
+      shstream ins;
+      decompress_stream(p.first, p.second, [&] (const char *data, int len) { ins.s.append(data, len); });
+      close_ruleset();
       hread_fpattern(ins, fp);
       
-      hread(ins, root);
-      hread(ins, children);
-      hread(ins, other);
-      fclose(f);
+      hread(ins, root_data);
+      hread(ins, children_data);
+      hread(ins, other_data);
+      root.set(root_data);
+      children.set(children_data);
+      other.set(other_data);
+      }
+
+    /** save the current rules in the uncompressed format */
+    void save_raw_ruleset(string fname) {
+      shstream fps;
+      hwrite_fpattern(fps, fp);
+      int32_t q[4] = { isize(fps.s), root.n, children.n, other.n };
+      fhstream f(fname, "wb");
+      if(!f.f) throw hstream_exception();
+      f.write_chars(raw_rule_magic, 8);
+      f.write_chars((const char*) q, sizeof(q));
+      while(isize(fps.s) & 3) fps.s += char(0);
+      f.write_chars(fps.s.data(), fps.s.size());
+      f.write_chars((const char*) root.ptr, sizeof(int) * root.n);
+      f.write_chars((const char*) children.ptr, sizeof(short) * children.n);
+      f.write_chars(other.ptr, other.n);
       }
     
-    /** \brief address = (fieldvalue, state) */
-    typedef pair<int, int> address;
-    
+    /** \brief number of states, and number of field values in quotient_map (1 in {5,3,5}) */
+    int qstate, qfv;
+
+    /** \brief address = fieldvalue * qstate + state */
+    int address(int fv, int state) { return fv * qstate + state; }
+
+    /** quotient_move[fv*S7+d] is the fieldvalue reached from fv in direction d */
+    vector<int> quotient_move;
+
     /** nles[x] lists the addresses from which we can reach address x 
-     *  without ever ending in the starting point */
+     *  without ever ending in the starting point; in CSR form, 
+     *  i.e., nles_list[nles_start[x]] ... nles_list[nles_start[x+1]-1], sorted */
+    vector<int> nles_start, nles_list;
 
-    map<address, set<address>> nonlooping_earlier_states;
+    /** possible states for the given fieldvalue, in CSR form */
+    vector<int> possible_start, possible_list;
+
+    rule_array<int> nonlooping_earlier_states(int a) {
+      rule_array<int> res;
+      res.ptr = nles_list.data() + nles_start[a];
+      res.n = nles_start[a+1] - nles_start[a];
+      return res;
+      }
 
-    vector<vector<int>> possible_states;
+    rule_array<int> possible_states(int fv) {
+      rule_array<int> res;
+      res.ptr = possible_list.data() + possible_start[fv];
+      res.n = possible_start[fv+1] - possible_start[fv];
+      return res;
+      }
 
     void find_mappings() {
-      auto &nles = nonlooping_earlier_states;
-      nles.clear();
-      vector<address> bfs;
-      int qty = isize(quotient_map->allh);
-      if(geometry == gSpace535) qty = 1;
-      for(int i=0; i<qty; i++) 
-        bfs.emplace_back(i, root[i]);
-      auto mov = [&] (int fv, int d) {
-        if(geometry == gSpace535) return 0;
-        return quotient_map->allh[fv]->move(d)->fieldval;
-        };
-      int qstate = isize(children) / S7;
+      int t0 = SDL_GetTicks();
+      qstate = isize(children) / S7;
+      qfv = geometry == gSpace535 ? 1 : isize(quotient_map->allh);
       DEBB(DF_GEOM, ("qstate = ", qstate));
-      for(int i=0; i<isize(bfs); i++) {
-        address last = bfs[i];
-        int state = last.second;
-        int fv = last.first;
+
+      quotient_move.resize(qfv * S7);
+      for(int fv=0; fv<qfv; fv++) for(int d=0; d<S7; d++)
+        quotient_move[fv*S7+d] = geometry == gSpace535 ? 0 : quotient_map->allh[fv]->move(d)->fieldval;
+
+      int N = qfv * qstate;
+      /* flags: 1 = visited in the first BFS, 2 = has an earlier state, 4 = processed, 8 = removed */
+      vector<char> flags(N, 0);
+      vector<int> bfs;
+      for(int i=0; i<qfv; i++) bfs.push_back(address(i, root[i])), flags[bfs.back()] |= 1;
+
+      /* distinct successors of a, i.e., the addresses for which a is an earlier state */
+      vector<int> succ(S7);
+      auto successors = [&] (int a) {
+        int fv = a / qstate, state = a % qstate, q = 0;
         for(int d=0; d<S7; d++) {
           int nstate = children[state*S7+d];
-          if(nstate >= 0) {
-            address next = {mov(fv, d), nstate};
-            if(!nles.count(next)) bfs.push_back(next);
-            nles[next].insert(last);
-            }
+          if(nstate < 0) continue;
+          int next = address(quotient_move[fv*S7+d], nstate);
+          bool dup = false;
+          for(int j=0; j<q; j++) if(succ[j] == next) dup = true;
+          if(!dup) succ[q++] = next;
+          }
+        return q;
+        };
+
+      vector<int> indeg(N+1, 0);
+      for(int i=0; i<isize(bfs); i++) {
+        int q = successors(bfs[i]);
+        for(int j=0; j<q; j++) {
+          int next = succ[j];
+          indeg[next]++;
+          flags[next] |= 2;
+          if(!(flags[next] & 1)) flags[next] |= 1, bfs.push_back(next);
           }
         }
-      
+
       vector<int> q(qstate, 0);
-      for(auto p: bfs) q[p.second]++;
-      vector<int> q2(isize(quotient_map->allh)+1, 0);
+      for(int a: bfs) q[a % qstate]++;
+      vector<int> q2(qfv+1, 0);
       for(auto p: q) q2[p]++;
       DEBB(DF_GEOM, ("q2 = ", q2));
-      
-      bfs = {};
-      for(int i=0; i<qty; i++) 
-        bfs.emplace_back(i, root[i]);
+
+      /* build the CSR of earlier states */
+      nles_start.assign(N+1, 0);
+      for(int a=0; a<N; a++) nles_start[a+1] = nles_start[a] + indeg[a];
+      nles_list.resize(nles_start[N]);
+      vector<int> fill(nles_start.begin(), nles_start.end()-1);
+      for(int a: bfs) {
+        int q = successors(a);
+        for(int j=0; j<q; j++) nles_list[fill[succ[j]]++] = a;
+        }
+      for(int a=0; a<N; a++) sort(nles_list.begin() + nles_start[a], nles_list.begin() + nles_start[a+1]);
+
+      /* remove the addresses all of whose earlier states have been processed */
+      bfs.clear();
+      for(int i=0; i<qfv; i++) bfs.push_back(address(i, root[i])), flags[bfs.back()] |= 4;
       for(int i=0; i<isize(bfs); i++) {
-        address last = bfs[i];
-        int state = last.second;
-        int fv = last.first;
-        for(int d=0; d<S7; d++) {
-          int nstate = children[state*S7+d];
-          if(nstate >= 0) {
-            address next = {mov(fv, d), nstate};
-            if(!nles.count(next)) continue;
-            int c = isize(nles[next]);
-            nles[next].erase(last);
-            if(nles[next].empty() && c) {
-              nles.erase(next);
-              bfs.push_back(next);
-              }
+        int q = successors(bfs[i]);
+        for(int j=0; j<q; j++) {
+          int next = succ[j];
+          if(!(flags[next] & 2) || (flags[next] & 8)) continue;
+          if(--indeg[next] == 0) {
+            flags[next] |= 8;
+            if(!(flags[next] & 4)) flags[next] |= 4, bfs.push_back(next);
             }
           }
         }
-      
+
       DEBB(DF_GEOM, ("removed cases = ", isize(bfs)));
-      
-      possible_states.resize(qstate);
-      for(auto& p: nonlooping_earlier_states)
-        possible_states[p.first.first].push_back(p.first.second);
+
+      /* compact: removed addresses lose their lists, and processed earlier states are dropped */
+      int k = 0;
+      possible_start.assign(qfv+1, 0);
+      possible_list.clear();
+      for(int a=0; a<N; a++) {
+        int from = nles_start[a], to = nles_start[a+1];
+        nles_start[a] = k;
+        if((flags[a] & 2) && !(flags[a] & 8)) {
+          possible_list.push_back(a % qstate);
+          possible_start[a / qstate + 1]++;
+          for(int i=from; i<to; i++) if(!(flags[nles_list[i]] & 4)) nles_list[k++] = nles_list[i];
+          }
+        }
+      nles_start[N] = k;
+      nles_list.resize(k);
+      nles_list.shrink_to_fit();
+      for(int fv=0; fv<qfv; fv++) possible_start[fv+1] += possible_start[fv];
+
+      size_t bytes = sizeof(int) * (quotient_move.size() + nles_start.size() + nles_list.size() + possible_start.size() + possible_list.size());
+      DEBB(DF_GEOM, ("find_mappings: ", N, " addresses, ", isize(possible_list), " nonlooping, ", int(SDL_GetTicks() - t0), " ms, ", int(bytes >> 10), " KB"));
       }
 
     hrmap_reg3_rule() : fp(0) {
@@ -1175,7 +1335,7 @@ EX namespace reg3 {
         vector<int> possible;
         int pfv = parent->fieldval;
         if(geometry == gSpace535) pfv = 0;
-        for(auto s: nonlooping_earlier_states[address{pfv, id}]) possible.push_back(s.second);
+        for(int s: nonlooping_earlier_states(address(pfv, id))) possible.push_back(s % qstate);
         id1 = hrand_elt(possible, 0);
         res->fiftyval = id1;
         find_emeraldval(res, parent, d);
@@ -1202,6 +1362,7 @@ EX namespace reg3 {
     ~hrmap_reg3_rule() {
       if(quotient_map) delete quotient_map;
       clearfrom(origin);
+      close_ruleset();
       }
     
     transmatrix adj(heptagon *h, int d) override {
@@ -1239,7 +1400,7 @@ EX void link_structures(heptagon *h, heptagon *alt, hstate firststate) {
     alt->fiftyval = cm->root[alt->fieldval];
     return;
     }
-  vector<int>& choices = cm->possible_states[alt->fieldval];
+  auto choices = cm->possible_states(alt->fieldval);
   vector<int> choices2;
   for(auto c: choices) {
     bool ok = true;
@@ -1262,10 +1423,15 @@ EX int rule_get_root(int i) {
   return ((hrmap_reg3_rule*)currentmap)->root[i];
   }
 
-EX const vector<short>& rule_get_children() {
+EX const rule_array<short>& rule_get_children() {
   return ((hrmap_reg3_rule*)currentmap)->children;
   }
 
+/** save the rules of the current map in the uncompressed format, which can be memory-mapped and used in place */
+EX void rule_save_raw(string fname) {
+  ((hrmap_reg3_rule*)currentmap)->save_raw_ruleset(fname);
+  }
+
 EX hrmap* new_map() {
   if(geometry == gSeifertCover) return new seifert_weber::hrmap_seifert_cover;
   if(geometry == gSeifertWeber) return new seifert_weber::hrmap_singlecell(108*degree);
@@ -16,29 +16,8 @@
 
 // press 'o' when flocking active to change the parameters.
 
-#ifdef USE_THREADS
-#include <thread>
-int threads = 1;
-#endif
-
-template<class T> auto parallelize(long long N, T action) -> decltype(action(0,0)) {
-#ifndef USE_THREADS
-  return action(0,N);
-#else
-  if(threads == 1) return action(0,N);
-  std::vector<std::thread> v;
-  typedef decltype(action(0,0)) Res;
-  std::vector<Res> results(threads);
-  for(int k=0; k<threads; k++)
-    v.emplace_back([&,k] () { 
-      results[k] = action(N*k/threads, N*(k+1)/threads); 
-      });
-  for(std::thread& t:v) t.join();
-  Res res = 0;
-  for(Res r: results) res += r;
-  return res;
-#endif
-  }
+// the simulation runs on the worker pool (see workers::parallel_for);
+// use -threads (before -flocking) to change the number of threads.
 
 #include "rogueviz.h"
 
@@ -55,7 +34,17 @@ namespace flocking {
   int follow = 0;
   string follow_names[3] = {"nothing", "specific boid", "center of mass"};
   
-  map<cell*, map<cell*, transmatrix>> relmatrices;
+  // the cells of the map, numbered in the order of allcells()
+  cell_index<char> cellid;
+
+  // for the cell numbered a, the entries rel_start[a] .. rel_start[a+1]-1 of rel_cell 
+  // and rel_matrix list the cells in check_range, and the matrices we have to multiply by to 
+  // change from their coordinates to the coordinates of a
+  vector<int> rel_start, rel_cell;
+  vector<transmatrix> rel_matrix;
+  
+  // boids sorted by their cells: the boids in the cell a are bucket[bucket_start[a] .. bucket_start[a+1]-1]
+  vector<int> bucket_start, bucket;
 
   ld ini_speed = .5;
   ld max_speed = 1;
@@ -95,20 +84,24 @@ namespace flocking {
     const auto v = currentmap->allcells();
     
     printf("computing relmatrices...\n");
-    // relmatrices[c1][c2] is the matrix we have to multiply by to 
-    // change from c1-relative coordinates to c2-relative coordinates
+    cellid.clear();
+    for(cell *c: v) cellid[c];
+    rel_start.clear(); rel_cell.clear(); rel_matrix.clear();
     for(cell* c1: v) {
+      rel_start.push_back(isize(rel_cell));
       manual_celllister cl;
       cl.add(c1);
       for(int i=0; i<isize(cl.lst); i++) {
         cell *c2 = cl.lst[i];
         transmatrix T = calc_relative_matrix(c2, c1, C0);
         if(hypot_d(WDIM, inverse_exp(shiftless(tC0(T)))) <= check_range) {
-          relmatrices[c1][c2] = T;
+          rel_cell.push_back(cellid.index_of(c2));
+          rel_matrix.push_back(T);
           forCellEx(c3, c2) cl.add(c3);
           }
         }
       }
+    rel_start.push_back(isize(rel_cell));
 
     printf("setting up...\n");
     for(int i=0; i<N; i++) {
@@ -142,19 +135,23 @@ namespace flocking {
     vector<transmatrix> pats(N);
     vector<transmatrix> oris(N);
     vector<ld> vels(N);
-    using shmup::monster;
+    vector<vector<tuple<shiftpoint, shiftpoint, color_t>>> boid_lines(draw_lines ? N : 0);
     
-    map<cell*, vector<monster*>> monsat;
-
+    // counting sort of the boids by their cells
+    int C = isize(rel_start) - 1;
+    vector<int> boid_cell(N);
+    bucket_start.assign(C+2, 0);
     for(int i=0; i<N; i++) {
-      vertexdata& vd = vdata[i];
-      auto m = vd.m;
-      monsat[m->base].push_back(m);
+      boid_cell[i] = cellid.index_of(vdata[i].m->base);
+      bucket_start[boid_cell[i]+2]++;
       }
+    for(int a=0; a<C; a++) bucket_start[a+2] += bucket_start[a+1];
+    bucket.resize(N);
+    for(int i=0; i<N; i++) bucket[bucket_start[boid_cell[i]+1]++] = i;
     
     lines.clear();
 
-    parallelize(N, [&monsat, &d, &vels, &pats, &oris] (int a, int b) { for(int i=a; i<b; i++) {
+    workers::parallel_for(0, N, 64, [&] (int a, int b) { for(int i=a; i<b; i++) {
       vertexdata& vd = vdata[i];
       auto m = vd.m;
       
@@ -189,11 +186,13 @@ namespace flocking {
       hyperpoint coh = hpxyz(0, 0, 0);
       int coh_count = 0;
       
-      for(auto& p: relmatrices[m->base]) {
-        auto f = monsat.find(p.first);
-        if(f != monsat.end()) for(auto m2: f->second) if(m != m2) {
+      int ci = boid_cell[i];
+      for(int r=rel_start[ci]; r<rel_start[ci+1]; r++) {
+        int c2 = rel_cell[r];
+        for(int k=bucket_start[c2]; k<bucket_start[c2+1]; k++) if(bucket[k] != i) {
+          auto m2 = vdata[bucket[k]].m;
           ld vel2 = m2->vel;
-          transmatrix at2 = I * p.second * m2->at;
+          transmatrix at2 = I * rel_matrix[r] * m2->at;
 
           // at2 is like m2->at but relative to m->at
           
@@ -231,7 +230,7 @@ namespace flocking {
             }
           
           if(col && draw_lines)
-            lines.emplace_back(m->pat * C0, m->pat * at2 * C0, col);          
+            boid_lines[i].emplace_back(m->pat * C0, m->pat * at2 * C0, col);          
           }
         }
       
@@ -265,7 +264,9 @@ namespace flocking {
         oris[i] = spin(+atan2(h[1], h[0])) * oris[i];
         }
       
-      } return 0; });
+      } });
+    
+    for(auto& bl: boid_lines) for(auto& l: bl) lines.push_back(l);
       
     for(int i=0; i<N; i++) {
       vertexdata& vd = vdata[i];
@@ -392,11 +393,14 @@ namespace flocking {
       shift(); ini_speed = argf();
       shift(); max_speed = argf();
       }
-    #ifdef USE_THREADS
-    else if(argis("-threads")) {
-      shift(); threads = argi();
+    // run the given number of simulation steps, and report the time taken
+    else if(argis("-flockbench")) {
+      shift(); int steps = argi();
+      int t0 = SDL_GetTicks();
+      for(int i=0; i<steps; i++) simulate(precision);
+      int t1 = SDL_GetTicks();
+      println(hlog, "flocking: ", isize(vdata), " boids, ", steps, " steps in ", t1-t0, " ms (", workers::get_threads(), " threads)");
       }
-    #endif
     else return 1;
     return 0;
     }
@@ -159,16 +159,55 @@ colorpair parse(string s) {
 
 vector<vertexdata> vdata;
 
-map<string, int> labeler;
+label_table labeler;
 
-int getid(const string& s) {
-  if(labeler.count(s)) return labeler[s];
-  else {
-    int id = isize(vdata);
-    vdata.resize(isize(vdata) + 1);
-    vdata[id].name = s;
-    return labeler[s] = id;
+unsigned label_table::hash(const char *s, int len) {
+  unsigned h = 2166136261u;
+  for(int i=0; i<len; i++) h = (h ^ (unsigned char) s[i]) * 16777619u;
+  return h;
+  }
+
+int label_table::find(const char *s, int len) const {
+  if(slots.empty()) return -1;
+  int mask = isize(slots) - 1;
+  for(int k = hash(s, len) & mask;; k = (k+1) & mask) {
+    int i = slots[k];
+    if(i < 0) return -1;
+    if(keys[i].second == len && memcmp(&pool[keys[i].first], s, len) == 0) return ids[i];
+    }
+  }
+
+void label_table::insert(const char *s, int len, int id) {
+  if(2 * (isize(keys) + 1) > isize(slots)) {
+    slots.assign(max(1024, 2 * isize(slots)), -1);
+    int mask = isize(slots) - 1;
+    for(int i=0; i<isize(keys); i++) {
+      int k = hash(&pool[keys[i].first], keys[i].second) & mask;
+      while(slots[k] >= 0) k = (k+1) & mask;
+      slots[k] = i;
+      }
     }
+  int mask = isize(slots) - 1;
+  int k = hash(s, len) & mask;
+  while(slots[k] >= 0) k = (k+1) & mask;
+  slots[k] = isize(keys);
+  keys.emplace_back(isize(pool), len);
+  ids.push_back(id);
+  pool.append(s, len);
+  }
+
+int getid(const char *s, int len) {
+  int id = labeler.find(s, len);
+  if(id >= 0) return id;
+  id = isize(vdata);
+  vdata.resize(isize(vdata) + 1);
+  vdata[id].name.assign(s, len);
+  labeler.insert(s, len, id);
+  return id;
+  }
+
+int getid(const string& s) {
+  return getid(s.data(), isize(s));
   }
 
 int getnewid(string s) {
@@ -279,53 +318,247 @@ namespace anygraph {
   
   void tst() {}
 
-  void read(string fn, bool subdiv, bool doRebase, bool doStore) {
-    init(&vzid, RV_GRAPH);
-    any = add_edgetype("embedded edges");
-    fname = fn;
-    fhstream f(fn + "-coordinates.txt", "rt");
-    if(!f.f) {
+  /** the whole contents of a text file, parsed in place */
+  struct text_buffer {
+    string data;
+    size_t pos;
+    bool load(const string& fname) {
+      FILE *f = fopen(fname.c_str(), "rb");
+      if(!f) return false;
+      data.clear(); pos = 0;
+      char buf[1<<16];
+      while(true) {
+        size_t qty = fread(buf, 1, sizeof(buf), f);
+        data.append(buf, qty);
+        if(qty < sizeof(buf)) break;
+        }
+      fclose(f);
+      return true;
+      }
+    void skip() { while(pos < data.size() && isspace((unsigned char) data[pos])) pos++; }
+    /** the next whitespace-separated token; len is 0 at the end of data */
+    const char *token(int& len) {
+      skip();
+      size_t start = pos;
+      while(pos < data.size() && !isspace((unsigned char) data[pos])) pos++;
+      len = int(pos - start);
+      return data.c_str() + start;
+      }
+    bool number(double& x) {
+      skip();
+      const char *s = data.c_str() + pos;
+      char *e;
+      x = strtod(s, &e);
+      pos += e - s;
+      return e != s;
+      }
+    bool number(int& x) {
+      skip();
+      const char *s = data.c_str() + pos;
+      char *e;
+      x = int(strtol(s, &e, 10));
+      pos += e - s;
+      return e != s;
+      }
+    };
+
+  /** if set, the parsed dataset is stored in fn-cache.bin, and read from there on later runs */
+  bool use_cache = false;
+
+  static const char cache_magic[9] = "RVGRAPH1";
+
+  /** the sizes and modification times of the text files, used to tell whether the cache is up to date */
+  vector<long long> source_stamp(const string& fn) {
+    vector<long long> res;
+    for(string suffix: {"-coordinates.txt", "-links.txt"}) {
+      struct stat st;
+      if(stat((fn + suffix).c_str(), &st) != 0) res.push_back(-1), res.push_back(-1);
+      else res.push_back(st.st_size), res.push_back(st.st_mtime);
+      }
+    return res;
+    }
+
+  /** the dataset as parsed: vertices are given by their indices in vdata, and may include vertices created before this dataset */
+  struct parsed_graph {
+    double R, alpha, T;
+    vector<int> coord_vertex;
+    vector<int> links;
+    };
+
+  void save_cache(const string& fn, int base, const parsed_graph& pg) {
+    string buf;
+    auto put = [&] (const void *p, size_t len) { buf.append((const char*) p, len); };
+    put(cache_magic, 8);
+    auto stamp = source_stamp(fn);
+    put(&stamp[0], sizeof(long long) * stamp.size());
+    put(&N, sizeof(N)); put(&pg.R, sizeof(double)); put(&pg.alpha, sizeof(double)); put(&pg.T, sizeof(double));
+    /* vertices are stored as indices into a table of names: first the vertices created by this dataset,
+     * in the order of creation, then the vertices which existed before and are referenced by it */
+    vector<int> names;
+    for(int i=base; i<isize(vdata); i++) names.push_back(i);
+    map<int, int> external;
+    auto local = [&] (vector<int> ids) {
+      for(int& v: ids) {
+        if(v >= base) { v -= base; continue; }
+        if(!external.count(v)) external[v] = isize(names), names.push_back(v);
+        v = external[v];
+        }
+      return ids;
+      };
+    auto coord_vertex = local(pg.coord_vertex);
+    auto links = local(pg.links);
+    int V = isize(names);
+    put(&V, sizeof(V));
+    for(int i: names) buf += vdata[i].name, buf += char(0);
+    int C = isize(coord_vertex);
+    put(&C, sizeof(C));
+    if(C) put(&coord_vertex[0], sizeof(int) * C);
+    if(C) put(&coords[isize(coords) - C], sizeof(pair<double, double>) * C);
+    int L = isize(links);
+    put(&L, sizeof(L));
+    if(L) put(&links[0], sizeof(int) * L);
+    FILE *f = fopen((fn + "-cache.bin").c_str(), "wb");
+    if(!f) { println(hlog, "cannot write ", fn, "-cache.bin"); return; }
+    if(fwrite(buf.data(), buf.size(), 1, f) != 1) println(hlog, "error writing ", fn, "-cache.bin");
+    fclose(f);
+    }
+
+  /** read the dataset from the cache; returns false if there is no valid cache, and then nothing is changed */
+  bool load_cache(const string& fn, parsed_graph& pg) {
+    text_buffer tb;
+    if(!tb.load(fn + "-cache.bin")) return false;
+    const string& d = tb.data;
+    size_t pos = 0;
+    auto get = [&] (void *p, size_t len) {
+      if(pos + len > d.size()) throw hstream_exception();
+      memcpy(p, d.data() + pos, len); pos += len;
+      };
+    /* a count of items of the given size, which must fit in the rest of the file */
+    auto get_count = [&] (size_t size) {
+      int n;
+      get(&n, sizeof(n));
+      if(n < 0 || size_t(n) > (d.size() - pos) / size) throw hstream_exception();
+      return n;
+      };
+    /* decode everything first; the vertices and coords are changed only if the whole cache is valid */
+    int cN;
+    parsed_graph res;
+    vector<pair<const char*, int>> names;
+    vector<pair<double, double>> ccoords;
+    try {
+      char magic[8];
+      get(magic, 8);
+      if(memcmp(magic, cache_magic, 8)) return false;
+      auto stamp = source_stamp(fn);
+      vector<long long> cached(stamp.size());
+      get(&cached[0], sizeof(long long) * cached.size());
+      if(cached != stamp) { println(hlog, "cache is out of date: ", fn, "-cache.bin"); return false; }
+      get(&cN, sizeof(cN)); get(&res.R, sizeof(double)); get(&res.alpha, sizeof(double)); get(&res.T, sizeof(double));
+      int V = get_count(1);
+      names.resize(V);
+      for(int i=0; i<V; i++) {
+        size_t e = d.find(char(0), pos);
+        if(e == string::npos) throw hstream_exception();
+        names[i] = make_pair(d.data() + pos, int(e - pos));
+        pos = e + 1;
+        }
+      int C = get_count(sizeof(int) + sizeof(pair<double, double>));
+      res.coord_vertex.resize(C);
+      if(C) get(&res.coord_vertex[0], sizeof(int) * C);
+      ccoords.resize(C);
+      if(C) get(&ccoords[0], sizeof(pair<double, double>) * C);
+      int L = get_count(sizeof(int));
+      res.links.resize(L);
+      if(L) get(&res.links[0], sizeof(int) * L);
+      for(int v: res.coord_vertex) if(v < 0 || v >= V) throw hstream_exception();
+      for(int v: res.links) if(v < 0 || v >= V) throw hstream_exception();
+      }
+    catch(hstream_exception&) {
+      println(hlog, "cache is corrupted: ", fn, "-cache.bin");
+      return false;
+      }
+    vector<int> ids;
+    for(auto& nm: names) ids.push_back(getid(nm.first, nm.second));
+    for(int& v: res.coord_vertex) v = ids[v];
+    for(int& v: res.links) v = ids[v];
+    N = cN;
+    for(auto& co: ccoords) coords.push_back(co);
+    pg = std::move(res);
+    println(hlog, "read ", fn, "-cache.bin");
+    return true;
+    }
+
+  void parse(const string& fn, int base, parsed_graph& pg) {
+    text_buffer f;
+    if(!f.load(fn + "-coordinates.txt")) {
       printf("Missing file: %s-coordinates.txt\n", fname.c_str());
       exit(1);
       }
     printf("Reading coordinates...\n");
-    string ignore;
-    if(!scan(f, ignore, ignore, ignore, ignore, N, anygraph::R, anygraph::alpha, anygraph::T)) {
+    int len;
+    for(int i=0; i<4; i++) f.token(len);
+    if(!f.number(N) || !f.number(pg.R) || !f.number(pg.alpha) || !f.number(pg.T)) {
       printf("Error: incorrect format of the first line\n"); exit(1);
       }
-    vdata.reserve(N);
+    vdata.reserve(base + N);
     while(true) {
-      string s = scan<string>(f);
-      println(hlog, "s: ", s.c_str());
-      if(s == "D11.11") tst();
-      if(s == "" || s == "#ROGUEVIZ_ENDOFDATA") break;
-      int id = getid(s);
-      vertexdata& vd(vdata[id]);
-      vd.name = s;
-      vd.cp = colorpair(dftcolor);
-      
+      const char *s = f.token(len);
+      if(len == 0 || (len == 19 && memcmp(s, "#ROGUEVIZ_ENDOFDATA", 19) == 0)) break;
+      pg.coord_vertex.push_back(getid(s, len));
+  
       double r, alpha;
-      if(!scan(f, r, alpha)) { printf("Error: incorrect format of r/alpha\n"); exit(1); }
+      if(!f.number(r) || !f.number(alpha)) { printf("Error: incorrect format of r/alpha\n"); exit(1); }
       coords.push_back(make_pair(r, alpha));
-  
-      transmatrix h = spin(alpha * degree) * xpush(r);
-      
-      createViz(id, currentmap->gamestart(), h);
       }
     
-    fhstream g(fn + "-links.txt", "rt");
-    if(!g.f) {
+    text_buffer g;
+    if(!g.load(fn + "-links.txt")) {
       println(hlog, "Missing file: ", fname, "-links.txt");
       exit(1);
       }
     println(hlog, "Reading links...");
-    int qlink = 0;
     while(true) {
-      int i = readLabel(g), j = readLabel(g);
-      if(i == -1 || j == -1) break;
-      addedge(i, j, 1, subdiv, any);
-      qlink++;
+      const char *s = g.token(len);
+      if(len == 0) break;
+      int i = getid(s, len);
+      s = g.token(len);
+      if(len == 0) break;
+      pg.links.push_back(i);
+      pg.links.push_back(getid(s, len));
+      }
+    }
+
+  void read(string fn, bool subdiv, bool doRebase, bool doStore) {
+    init(&vzid, RV_GRAPH);
+    any = add_edgetype("embedded edges");
+    fname = fn;
+
+    int base = isize(vdata);
+    int cbase = isize(coords);
+    parsed_graph pg;
+    if(!(use_cache && load_cache(fn, pg))) {
+      parse(fn, base, pg);
+      if(use_cache) save_cache(fn, base, pg);
+      }
+    anygraph::R = pg.R; anygraph::alpha = pg.alpha; anygraph::T = pg.T;
+
+    for(int k=0; k<isize(pg.coord_vertex); k++) {
+      int id = pg.coord_vertex[k];
+      vertexdata& vd(vdata[id]);
+      vd.cp = colorpair(dftcolor);
+      auto& co = coords[cbase + k];
+      transmatrix h = spin(co.second * degree) * xpush(co.first);
+      createViz(id, currentmap->gamestart(), h);
       }
+
+    /* reserve the edge lists first, so that they are not reallocated while adding */
+    vector<int> deg(isize(vdata), 0);
+    for(int v: pg.links) deg[v]++;
+    for(int i=base; i<isize(vdata); i++) vdata[i].edges.reserve(vdata[i].edges.size() + deg[i]);
+    edgeinfos.reserve(edgeinfos.size() + pg.links.size() / 2);
+
+    for(int k=0; k<isize(pg.links); k+=2)
+      addedge(pg.links[k], pg.links[k+1], 1, subdiv, any);
   
     if(doRebase) {
       printf("Rebasing...\n");
@@ -571,6 +804,82 @@ void queue_prec(const shiftmatrix& V, edgeinfo*& ei, color_t col) {
   #endif
   }
 
+/* Edges of the same type and color are collected during the frame, and queued as
+ * a single GL_LINES item in flush_edge_batches(). The subdivided polylines (ei->prec)
+ * are kept relative to the cell of the first endpoint, so they only need to be
+ * recomputed when one of the endpoints changes its cell. */
+
+bool batch_edges = true;
+
+/* do not use the worker threads for batches smaller than this (in vertices) */
+int edge_threads_min = 20000;
+
+struct edge_batch {
+  ld shift;
+  vector<pair<transmatrix, edgeinfo*>> edges;
+  vector<glvertex> lines;
+  };
+
+map<pair<edgetype*, color_t>, edge_batch> edge_batches;
+
+void batch_edge(const shiftmatrix& T, edgeinfo *ei, color_t col) {
+  auto& b = edge_batches[make_pair(ei->type, col)];
+  if(b.edges.empty()) b.shift = T.shift;
+  if(b.shift != T.shift) { queue_prec(T, ei, col); return; }
+  b.edges.emplace_back(T.T, ei);
+  }
+
+void flush_edge_batches() {
+  struct job { const transmatrix *T; const vector<glvertex> *prec; glvertex *out; };
+  vector<job> jobs;
+  long long total = 0;
+
+  for(auto it = edge_batches.begin(); it != edge_batches.end();) {
+    auto& b = it->second;
+    if(b.edges.empty()) { it = edge_batches.erase(it); continue; }
+    int qty = 0;
+    for(auto& e: b.edges) qty += 2 * max(isize(e.second->prec) - 1, 0);
+    b.lines.resize(qty);
+    glvertex *out = b.lines.data();
+    for(auto& e: b.edges) {
+      int n = isize(e.second->prec);
+      if(n < 2) continue;
+      jobs.push_back(job{&e.first, &e.second->prec, out});
+      out += 2 * (n-1);
+      }
+    total += qty;
+    it++;
+    }
+
+  auto run = [&] (int from, int to) {
+    for(int k=from; k<to; k++) {
+      auto& j = jobs[k];
+      auto& prec = *j.prec;
+      glvertex *out = j.out;
+      glvertex last = glhr::pointtogl(*j.T * glhr::gltopoint(prec[0]));
+      for(int i=1; i<isize(prec); i++) {
+        glvertex next = glhr::pointtogl(*j.T * glhr::gltopoint(prec[i]));
+        *(out++) = last; *(out++) = next;
+        last = next;
+        }
+      }
+    };
+
+  int N = isize(jobs);
+  if(total >= edge_threads_min)
+    workers::parallel_for(0, N, 256, run);
+  else
+    run(0, N);
+
+  for(auto& p: edge_batches) {
+    auto& b = p.second;
+    if(b.lines.empty()) { b.edges.clear(); continue; }
+    auto& t = queuetable(shiftless(Id, b.shift), b.lines, isize(b.lines), p.first.second, 0, PPR::STRUCT0);
+    t.flags |= POLY_LINES;
+    b.edges.clear();
+    }
+  }
+
 bool drawVertex(const shiftmatrix &V, cell *c, shmup::monster *m) {
   if(m->dead) return true;
   if(m->type != moRogueviz) return false;
@@ -667,6 +976,16 @@ bool drawVertex(const shiftmatrix &V, cell *c, shmup::monster *m) {
       else if(pmodel && !fat_edges) {
         queueline(h1, h2, col, 2 + vid.linequality).prio = PPR::STRUCT0;
         }
+      else if(batch_edges && !multidraw && !elliptic && !fat_edges && !svg::in) {
+        if(ei->orig != vd1.m->base || ei->orig_to != vd2.m->base) {
+          ei->orig = vd1.m->base;
+          ei->orig_to = vd2.m->base;
+          ei->prec.clear();
+          if(callhandlers(false, hooks_alt_edges, ei, true)) ;
+          else storeline(ei->prec, inverse_shift(gm1, h1), inverse_shift(gm1, h2));
+          }
+        batch_edge(ggmatrix(ei->orig), ei, col);
+        }
       else {
       
         cell *center = multidraw ? c : centerover;
@@ -675,6 +994,7 @@ bool drawVertex(const shiftmatrix &V, cell *c, shmup::monster *m) {
           ei->orig = NULL;
         if(!ei->orig) {
           ei->orig = center; // cwt.at;
+          ei->orig_to = NULL;
           ei->prec.clear();
           
           shiftmatrix T = ggmatrix(ei->orig);
@@ -931,6 +1251,10 @@ int readArgs() {
   else if(argis("-graph")) {
     PHASE(3); shift(); anygraph::read(args());
     }
+  // store the parsed graph in a binary file next to the dataset, and reuse it later
+  else if(argis("-graph-cache")) {
+    anygraph::use_cache = true;
+    }
   
 // graphical parameters
 //------------------
@@ -954,6 +1278,9 @@ int readArgs() {
   else if(argis("-rvedgehi")) {
     shift(); default_edgetype.color_hi = arghex();
     }
+  else if(argis("-rv-edge-batch")) {
+    shift(); batch_edges = argi();
+    }
   else if(argis("-rvfat")) {
     shift(); 
     fat_edges = argf();
@@ -1230,6 +1557,7 @@ auto hooks  =
   addHook(hooks_clearmemory, 0, close) +
   addHook(hooks_prestats, 100, rogueviz_hud) +
   addHook(shmup::hooks_draw, 100, drawVertex) +
+  addHook(hooks_frame, 100, flush_edge_batches) +
   addHook(shmup::hooks_describe, 100, describe_monster) +
   addHook(shmup::hooks_kill, 100, activate) +
   addHook(hooks_o_key, 100, o_key) +
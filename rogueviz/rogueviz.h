@@ -57,10 +57,10 @@ namespace rogueviz {
     double weight, weight2;
     vector<glvertex> prec;
     basic_textureinfo tinf;
-    cell *orig;
+    cell *orig, *orig_to;
     int lastdraw;
     edgetype *type;
-    edgeinfo(edgetype *t) { orig = NULL; lastdraw = -1; type = t; }
+    edgeinfo(edgetype *t) { orig = orig_to = NULL; lastdraw = -1; type = t; }
     };
 
   extern vector<edgeinfo*> edgeinfos;
@@ -173,7 +173,22 @@ function<void(presmode)> roguevizslide_action(char c, const T& t, const U& act)
 
   void createViz(int id, cell *c, transmatrix at);
 
-  extern map<string, int> labeler;
+  /** hashed table of vertex labels; ids are indices into vdata */
+  struct label_table {
+    string pool;
+    vector<pair<int, int>> keys;
+    vector<int> ids;
+    vector<int> slots;
+    label_table() {}
+    int find(const char *s, int len) const;
+    void insert(const char *s, int len, int id);
+    int count(const string& s) const { return find(s.data(), isize(s)) >= 0; }
+    void clear() { pool.clear(); keys.clear(); ids.clear(); slots.clear(); }
+    private:
+    static unsigned hash(const char *s, int len);
+    };
+
+  extern label_table labeler;
   int getid(const string& s);
   int getnewid(string s);
   extern string fname;
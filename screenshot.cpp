@@ -22,13 +22,49 @@ EX always_false in;
 #endif
 
 #if CAP_SVG
-  #if ISWEB
-  shstream f;
-  #else
-  fhstream f;
-  #endif
+  /** \brief buffered output for the SVG renderer
+   *
+   *  Numbers are formatted directly into the buffer with a fixed precision,
+   *  so no temporary strings are created for the elements. In the web version
+   *  nothing is flushed, and the buffer is the result.
+   */
+  struct svg_writer {
+    FILE *f;
+    string buf;
+    svg_writer() { f = NULL; }
+    void flush() { if(f && !buf.empty()) { fwrite(buf.data(), buf.size(), 1, f); buf.clear(); } }
+    void check() { if(f && isize(buf) >= (1<<16)) flush(); }
+    void put(char c) { buf += c; }
+    void put(const char *s) { buf.append(s); check(); }
+    void put(const string& s) { buf.append(s); check(); }
+    void put_uint(unsigned long long v) {
+      char tmp[24]; int i = 0;
+      do { tmp[i++] = '0' + v % 10; v /= 10; } while(v);
+      while(i) buf += tmp[--i];
+      }
+    void put_int(long long v) { if(v < 0) { put('-'); v = -v; } put_uint(v); }
+    void put_fixed(ld x, int digits) {
+      static const long long pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+      long long v = llround(x * pow10[digits]);
+      if(v < 0) { put('-'); v = -v; }
+      put_uint(v / pow10[digits]);
+      if(!digits) return;
+      put('.');
+      long long r = v % pow10[digits];
+      for(int d=digits-1; d>=0; d--) put(char('0' + r / pow10[d] % 10));
+      }
+    void put_hex6(color_t col) {
+      static const char *hex = "0123456789abcdef";
+      for(int i=20; i>=0; i-=4) put(hex[(col >> i) & 15]);
+      }
+    };
+
+  svg_writer f;
   
   EX bool in = false;
+
+  /** reuse the shapes via <defs> and <use> */
+  EX bool reuse_shapes = false;
   
   ld cta(color_t col) {
     // col >>= 24;
@@ -46,25 +82,14 @@ EX always_false in;
   int svgsize;
   EX int divby = 10;
   
-  const char* coord(int val) {
-    static char buf[10][20];
-    static int id;
-    id++; id %= 10;
-    if(divby == 1) {
-      sprintf(buf[id], "%d", val); return buf[id];
-      }
-    else if(divby <= 10) {
-      sprintf(buf[id], "%.1f", val*1./divby); return buf[id];
-      }
-    else {
-      sprintf(buf[id], "%.2f", val*1./divby); return buf[id];
-      }
+  void coord(int val) {
+    if(divby == 1) f.put_int(val);
+    else f.put_fixed(val*1./divby, divby <= 10 ? 1 : 2);
     }
   
-  char* stylestr(color_t fill, color_t stroke, ld width=1) {
+  void stylestr(color_t fill, color_t stroke, ld width=1) {
     fixgamma(fill);
     fixgamma(stroke);
-    static char buf[600];
     // printf("fill = %08X stroke = %08x\n", fill, stroke);
   
     if(stroke == 0xFF00FF && false) {
@@ -76,31 +101,36 @@ EX always_false in;
       else fill = 0xFFFFFFFF;
       }
     
-    sprintf(buf, "style=\"stroke:#%06x;stroke-opacity:%.3" PLDF ";stroke-width:%" PLDF "px;fill:#%06x;fill-opacity:%.3" PLDF "\"",
-      (stroke>>8) & 0xFFFFFF, cta(stroke),
-      width/divby,
-      (fill>>8) & 0xFFFFFF, cta(fill)
-      );
-    return buf;
+    f.put("style=\"stroke:#"); f.put_hex6(stroke >> 8);
+    f.put(";stroke-opacity:"); f.put_fixed(cta(stroke), 3);
+    f.put(";stroke-width:"); f.put_fixed(width/divby, 6);
+    f.put("px;fill:#"); f.put_hex6(fill >> 8);
+    f.put(";fill-opacity:"); f.put_fixed(cta(fill), 3);
+    f.put('"');
     }
   
   EX void circle(int x, int y, int size, color_t col, color_t fillcol, double linewidth) {
     if(!invisible(col) || !invisible(fillcol)) {
-      if(pconf.stretch == 1)
-        println(f, "<circle cx='", coord(x), "' cy='", coord(y), "' r='", coord(size), "' ", stylestr(fillcol, col, linewidth), "/>");
-      else
-        println(f, "<ellipse cx='", coord(x), "' cy='", coord(y), "' rx='", coord(size), "' ry='", coord(size*pconf.stretch), "' ", stylestr(fillcol, col), "/>");
+      if(pconf.stretch == 1) {
+        f.put("<circle cx='"); coord(x); f.put("' cy='"); coord(y); f.put("' r='"); coord(size); f.put("' ");
+        stylestr(fillcol, col, linewidth);
+        }
+      else {
+        f.put("<ellipse cx='"); coord(x); f.put("' cy='"); coord(y); f.put("' rx='"); coord(size); f.put("' ry='"); coord(size*pconf.stretch); f.put("' ");
+        stylestr(fillcol, col);
+        }
+      f.put("/>\n");
       }
     }
   
   EX string link;
   
   void startstring() {
-    if(link != "") print(f, "<a xlink:href=\"", link, "\" xlink:show=\"replace\">");
+    if(link != "") { f.put("<a xlink:href=\""); f.put(link); f.put("\" xlink:show=\"replace\">"); }
     }
 
   void stopstring() {
-    if(link != "") print(f, "</a>");
+    if(link != "") f.put("</a>");
     }
 
   string font = "Times";
@@ -124,66 +154,147 @@ EX always_false in;
 
     if(!invisible(col)) {
       startstring();
-      string str2 = "";
-      for(int i=0; i<(int) str.size(); i++)
-        if(str[i] == '&')
-          str2 += "&amp;";
-        else if(str[i] == '<')
-          str2 += "&lt;";
-        else if(str[i] == '>')
-          str2 += "&gt;";
-        else if(uselatex && str[i] == '#')
-          str2 += "\\#";
-        else str2 += str[i];
-      if(uselatex) str2 = string("\\myfont{")+coord(size)+"}{" + str2 + "}";  
-      
-      print(f, "<text x='", coord(x), "' y='", coord(y+size*.4), "' text-anchor='", align == 8 ? "middle" :
-        align < 8 ? "start" :
-        "end", "' ");
-      if(!uselatex)
-        print(f, "font-family='", font, "' font-size='", coord(size), "' ");
-      print(f, 
-        stylestr(col, frame ? 0x0000000FF : 0, (1<<get_sightrange())*dfc*text_width_multiplier), 
-        ">", str2, "</text>");
+      f.put("<text x='"); coord(x); f.put("' y='"); coord(y+size*.4); f.put("' text-anchor='");
+      f.put(align == 8 ? "middle" : align < 8 ? "start" : "end");
+      f.put("' ");
+      if(!uselatex) {
+        f.put("font-family='"); f.put(font); f.put("' font-size='"); coord(size); f.put("' ");
+        }
+      stylestr(col, frame ? 0x0000000FF : 0, (1<<get_sightrange())*dfc*text_width_multiplier);
+      f.put(">");
+      if(uselatex) { f.put("\\myfont{"); coord(size); f.put("}{"); }
+      for(char c: str)
+        if(c == '&')
+          f.put("&amp;");
+        else if(c == '<')
+          f.put("&lt;");
+        else if(c == '>')
+          f.put("&gt;");
+        else if(uselatex && c == '#')
+          f.put("\\#");
+        else f.put(c);
+      if(uselatex) f.put("}");
+      f.put("</text>");
       stopstring();
-      println(f);
+      f.put("\n");
       }
     }
+
+  /** a shape which has been put into <defs>, in the coordinates of its first occurrence */
+  struct shape_def {
+    int id;
+    vector<int> x, y;
+    };
   
-  EX void polygon(int *polyx, int *polyy, int polyi, color_t col, color_t outline, double linewidth) {
+  map<tuple<const void*, int, int>, shape_def> shape_defs;
+
+  /** find the affine map M taking d to polyx/polyy (x' = M[0] x + M[2] y + M[4], y' = M[1] x + M[3] y + M[5]) */
+  bool find_affine(const shape_def& d, int *polyx, int *polyy, int polyi, ld *M) {
+    auto cross = [&] (int i, int j) { 
+      return ld(d.x[i] - d.x[0]) * (d.y[j] - d.y[0]) - ld(d.y[i] - d.y[0]) * (d.x[j] - d.x[0]);
+      };
+    int j = 0;
+    for(int i=1; i<polyi; i++)
+      if(hypot(d.x[i]-d.x[0], d.y[i]-d.y[0]) > hypot(d.x[j]-d.x[0], d.y[j]-d.y[0])) j = i;
+    int k = 0;
+    for(int i=1; i<polyi; i++) if(abs(cross(j, i)) > abs(cross(j, k))) k = i;
+    ld det = cross(j, k);
+    if(abs(det) < 1e-3) return false;
+    ld ux = d.x[j] - d.x[0], uy = d.y[j] - d.y[0], vx = d.x[k] - d.x[0], vy = d.y[k] - d.y[0];
+    ld ux1 = polyx[j] - polyx[0], uy1 = polyy[j] - polyy[0], vx1 = polyx[k] - polyx[0], vy1 = polyy[k] - polyy[0];
+    M[0] = (ux1 * vy - vx1 * uy) / det;
+    M[2] = (vx1 * ux - ux1 * vx) / det;
+    M[1] = (uy1 * vy - vy1 * uy) / det;
+    M[3] = (vy1 * ux - uy1 * vx) / det;
+    M[4] = polyx[0] - M[0] * d.x[0] - M[2] * d.y[0];
+    M[5] = polyy[0] - M[1] * d.x[0] - M[3] * d.y[0];
+    for(int i=0; i<polyi; i++) {
+      ld x = M[0] * d.x[i] + M[2] * d.y[i] + M[4];
+      ld y = M[1] * d.x[i] + M[3] * d.y[i] + M[5];
+      if(abs(x - polyx[i]) > 2 || abs(y - polyy[i]) > 2) return false;
+      }
+    return true;
+    }
+  
+  void path_data(int *polyx, int *polyy, int polyi) {
+    f.put("d=\"M ");
+    for(int i=0; i<polyi; i++) {
+      if(i) f.put(" L ");
+      coord(polyx[i]); f.put(' '); coord(polyy[i]);
+      }
+    f.put("\" ");
+    }
+  
+  /** draw a polygon; if reuse_shapes is on, the polygons with the same shape_id and offset are drawn by reusing the same path */
+  EX void polygon(int *polyx, int *polyy, int polyi, color_t col, color_t outline, double linewidth, const void *shape_id IS(nullptr), int shape_offset IS(0)) {
   
     if(invisible(col) && invisible(outline)) return;
     if(polyi < 2) return;
+    
+    ld width = (hyperbolic ? current_display->radius : current_display->scrsize) * linewidth/256;
 
     startstring();
-    for(int i=0; i<polyi; i++) {
-      if(i == 0)
-        print(f, "<path d=\"M ");
-      else
-        print(f, " L ");
-      print(f, coord(polyx[i]), " ", coord(polyy[i]));
+    if(reuse_shapes && shape_id && polyi >= 3) {
+      auto key = make_tuple(shape_id, shape_offset, polyi);
+      ld M[6];
+      bool found = shape_defs.count(key);
+      if(!found) {
+        auto& d = shape_defs[key];
+        d.id = isize(shape_defs);
+        d.x.assign(polyx, polyx+polyi);
+        d.y.assign(polyy, polyy+polyi);
+        f.put("<defs><path id=\"s"); f.put_int(d.id); f.put("\" ");
+        path_data(polyx, polyy, polyi);
+        f.put("vector-effect=\"non-scaling-stroke\"/></defs>\n");
+        }
+      auto& d = shape_defs[key];
+      if(!found || find_affine(d, polyx, polyy, polyi, M)) {
+        f.put("<use xlink:href=\"#s"); f.put_int(d.id); f.put("\" ");
+        if(found) {
+          f.put("transform=\"matrix(");
+          for(int i=0; i<6; i++) {
+            if(i) f.put(' ');
+            if(i < 4) f.put_fixed(M[i], 6); 
+            else f.put_fixed(M[i] / divby, 3);
+            }
+          f.put(")\" ");
+          }
+        stylestr(col, outline, width);
+        f.put("/>");
+        stopstring();
+        f.put("\n");
+        return;
+        }
       }
-    
-    print(f, "\" ", stylestr(col, outline, (hyperbolic ? current_display->radius : current_display->scrsize) * linewidth/256), "/>");
+
+    f.put("<path ");
+    path_data(polyx, polyy, polyi);
+    stylestr(col, outline, width);
+    f.put("/>");
     stopstring();
-    println(f);
+    f.put("\n");
     }
   
   EX void render(const string& fname, const function<void()>& what IS(shot::default_screenshot_content)) {
     dynamicval<bool> v2(in, true);
     dynamicval<bool> v3(vid.usingGL, false);
     
-    #if ISWEB
-    f.s = "";
-    #else
+    f.buf.clear();
+    shape_defs.clear();
+    #if !ISWEB
     f.f = fopen(fname.c_str(), "wt");
     #endif
 
-    println(f, "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"", coord(vid.xres), "\" height=\"", coord(vid.yres), "\">");
-    if(!shot::transparent)
-      println(f, "<rect width=\"", coord(vid.xres), "\" height=\"", coord(vid.yres), "\" ", stylestr((backcolor << 8) | 0xFF, 0, 0), "/>");
+    f.put("<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\""); coord(vid.xres); 
+    f.put("\" height=\""); coord(vid.yres); f.put("\">\n");
+    if(!shot::transparent) {
+      f.put("<rect width=\""); coord(vid.xres); f.put("\" height=\""); coord(vid.yres); f.put("\" ");
+      stylestr((backcolor << 8) | 0xFF, 0, 0);
+      f.put("/>\n");
+      }
     what();
-    println(f, "</svg>");
+    f.put("</svg>\n");
+    shape_defs.clear();
     
     #if ISWEB
     EM_ASM_({
@@ -191,8 +302,9 @@ EX always_false in;
       x.document.open();
       x.document.write(UTF8ToString($0));
       x.document.close();
-      }, f.s.c_str());
+      }, f.buf.c_str());
     #else
+    f.flush();
     fclose(f.f); f.f = NULL;
     #endif
     }
@@ -227,6 +339,9 @@ int read_args() {
   else if(argis("-svgmt")) {
     shift(); svg::min_text = argi();
     }
+  else if(argis("-svgreuse")) {
+    shift(); svg::reuse_shapes = argi();
+    }
   else return 1;
   return 0;
   }
@@ -685,15 +800,8 @@ void output(SDL_Surface* s, const string& fname) {
     IMAGESAVE(s, fname.c_str());
   }
 
-EX void postprocess(string fname, SDL_Surface *sdark, SDL_Surface *sbright) {
-  if(gamma == 1 && shot_aa == 1 && sdark == sbright) {
-    output(sdark, fname);
-    return;
-    }
-
-  SDL_Surface *sout = empty_surface(shotx, shoty, sdark != sbright);
-  for(int y=0; y<shoty; y++)
-  for(int x=0; x<shotx; x++) {
+/** compute the output pixel (x,y) from the shot_aa x shot_aa block of the rendered surfaces */
+color_t postprocess_pixel(SDL_Surface *sdark, SDL_Surface *sbright, int x, int y) {
     int val[2][4];
     for(int a=0; a<2; a++) for(int b=0; b<3; b++) val[a][b] = 0;
     for(int ax=0; ax<shot_aa; ax++) for(int ay=0; ay<shot_aa; ay++)
@@ -705,8 +813,7 @@ EX void postprocess(string fname, SDL_Surface *sdark, SDL_Surface *sbright) {
     
     for(int p=0; p<3; p++) transparent += val[1][p] - val[0][p];
     
-    color_t& pix = qpixel(sout, x, y);
-    pix = 0;
+    color_t pix = 0;
     part(pix, 3) = 255 - (255 * transparent + (maxval/2)) / maxval;
     
     if(transparent < maxval) for(int p=0; p<3; p++) {
@@ -716,15 +823,83 @@ EX void postprocess(string fname, SDL_Surface *sdark, SDL_Surface *sbright) {
       if(v > 255) v = 255;
       part(pix, p) = v;
       }
+    return pix;
     }
+
+EX void postprocess(string fname, SDL_Surface *sdark, SDL_Surface *sbright) {
+  if(gamma == 1 && shot_aa == 1 && sdark == sbright) {
+    output(sdark, fname);
+    return;
+    }
+
+  SDL_Surface *sout = empty_surface(shotx, shoty, sdark != sbright);
+  for(int y=0; y<shoty; y++)
+  for(int x=0; x<shotx; x++)
+    qpixel(sout, x, y) = postprocess_pixel(sdark, sbright, x, y);
   output(sout, fname);
   SDL_FreeSurface(sout);
   }
+
+/** \brief writes the output image row by row
+ *
+ *  Used by the tiled renderer, so that the whole image never has to be kept in memory.
+ */
+struct row_writer {
+  FILE *f;
+  png_structp png;
+  png_infop info;
+  bool ok;
+  bool alpha;
+  int width;
+  vector<png_byte> buf;
+
+  row_writer(const string& fname, int x, int y, bool _alpha) : f(nullptr), png(nullptr), info(nullptr), ok(false), alpha(_alpha), width(x) {
+    if(format == screenshot_format::rawfile) return;
+    f = fopen(fname.c_str(), "wb");
+    if(!f) { println(hlog, "failed to open ", fname); return; }
+    png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if(png) info = png_create_info_struct(png);
+    if(!info) { println(hlog, "failed to create the PNG structures"); return; }
+    if(setjmp(png_jmpbuf(png))) { println(hlog, "failed to write ", fname); return; }
+    png_init_io(png, f);
+    png_set_IHDR(png, info, x, y, 8, alpha ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_RGB,
+      PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+    buf.resize(x * (alpha ? 4 : 3));
+    ok = true;
+    }
+
+  void add_row(color_t *row) {
+    if(format == screenshot_format::rawfile) {
+      ignore(write(rawfile_handle, row, 4 * width));
+      return;
+      }
+    if(!ok) return;
+    png_byte *p = &buf[0];
+    for(int x=0; x<width; x++) {
+      *(p++) = part(row[x], 2);
+      *(p++) = part(row[x], 1);
+      *(p++) = part(row[x], 0);
+      if(alpha) *(p++) = part(row[x], 3);
+      }
+    if(setjmp(png_jmpbuf(png))) { println(hlog, "failed to write a PNG row"); ok = false; return; }
+    png_write_row(png, &buf[0]);
+    }
+
+  ~row_writer() {
+    if(ok && !setjmp(png_jmpbuf(png))) png_write_end(png, NULL);
+    if(png) png_destroy_write_struct(&png, info ? &info : NULL);
+    if(f) fclose(f);
+    }
+  };
 #endif
 
 EX purehookset hooks_take;
 
 #if CAP_PNG
+/** if positive, PNG screenshots larger than this (in output pixels) are rendered in tiles of this size */
+EX int tile_size = 0;
+
 void render_png(string fname, const function<void()>& what) {
   resetbuffer rb;
 
@@ -756,6 +931,109 @@ void render_png(string fname, const function<void()>& what) {
     }
   else postprocess(fname, sdark, sdark);
   }
+
+/** \brief render the screenshot in tiles of tile_size x tile_size output pixels
+ *
+ *  Each tile is rendered by shifting the projection center, postprocessed, and
+ *  streamed into the output row by row, so the memory used depends on the tile size
+ *  and the image width rather than the whole output size. The HUD and the caption
+ *  are disabled, since their positions are given in screen coordinates.
+ */
+void render_png_tiled(string fname, const function<void()>& what) {
+  resetbuffer rb;
+  auto cd = current_display;
+
+  dynamicval<color_t> v8(backcolor, transparent ? 0xFF000000 : backcolor);
+  dynamicval<bool> vn(nohud, true);
+  dynamicval<string> vc(caption, "");
+
+  int full_xres = vid.xres;
+  row_writer out(fname, shotx, shoty, transparent);
+  vector<color_t> strip;
+
+  for(int y0=0; y0<shoty; y0+=tile_size) {
+    int th = min(tile_size, shoty - y0);
+    strip.resize(shotx * th);
+    for(int x0=0; x0<shotx; x0+=tile_size) {
+      int tw = min(tile_size, shotx - x0);
+      dynamicval<int> vx(vid.xres, tw * shot_aa);
+      dynamicval<int> vy(vid.yres, th * shot_aa);
+      dynamicval<ld> vxt(cd->xtop, 0), vyt(cd->ytop, 0);
+      dynamicval<ld> vxs(cd->xsize, vid.xres), vys(cd->ysize, vid.yres);
+      dynamicval<int> vxc(cd->xcenter, cd->xcenter - x0 * shot_aa);
+      dynamicval<int> vyc(cd->ycenter, cd->ycenter - y0 * shot_aa);
+      dynamicval<ld> vtf(cd->tanfov, cd->tanfov * vid.xres / full_xres);
+
+      auto render_tile = [&] (renderbuffer& glbuf) {
+        glbuf.enable();
+        cd->set_viewport(0);
+        #if CAP_RUG
+        if(rug::rugged && !rug::renderonce) rug::prepareTexture();
+        #endif
+        glbuf.clear(backcolor);
+        what();
+        return glbuf.render();
+        };
+
+      renderbuffer glbuf(vid.xres, vid.yres, vid.usingGL);
+      SDL_Surface *sdark = render_tile(glbuf);
+      SDL_Surface *sbright = sdark;
+      renderbuffer glbuf1(vid.xres, vid.yres, vid.usingGL);
+      if(transparent) {
+        dynamicval<color_t> vb(backcolor, 0xFFFFFFFF);
+        sbright = render_tile(glbuf1);
+        }
+
+      for(int y=0; y<th; y++)
+      for(int x=0; x<tw; x++)
+        strip[y * shotx + x0 + x] = 
+          (gamma == 1 && shot_aa == 1 && !transparent) ? (qpixel(sdark, x, y) | 0xFF000000) :
+          postprocess_pixel(sdark, sbright, x, y);
+      }
+    for(int y=0; y<th; y++) out.add_row(&strip[y * shotx]);
+    }
+  }
+#endif
+
+#if CAP_PNG && !ISWINDOWS
+/** raw BGRA frames go to the standard output (e.g. to pipe -animrecord into ffmpeg),
+ *  and anything printed is moved to the standard error */
+EX void stream_to_stdout() {
+  fflush(stdout);
+  rawfile_handle = dup(1);
+  ignore(dup2(2, 1));
+  format = screenshot_format::rawfile;
+  }
+#endif
+
+#if CAP_PNG
+/** when the program was started; SDL_GetTicks cannot be used for the benchmark, since SDL is not initialized with -offscreen */
+std::chrono::steady_clock::time_point process_start = std::chrono::steady_clock::now();
+
+/** the number of milliseconds since t */
+ld ms_since(std::chrono::steady_clock::time_point t) {
+  return std::chrono::duration<ld, std::milli>(std::chrono::steady_clock::now() - t).count();
+  }
+
+/** render frames of the current scene as screenshots, discarding the output, and report the throughput;
+ *  the view is rotated a bit every frame, so that every frame is really drawn */
+EX void benchmark(int frames) {
+  ld started = ms_since(process_start);
+  FILE *f = fopen(ISWINDOWS ? "NUL" : "/dev/null", "wb");
+  if(!f) { println(hlog, "cannot open the null device"); return; }
+  dynamicval<screenshot_format> sf(format, screenshot_format::rawfile);
+  dynamicval<int> sh(rawfile_handle, fileno(f));
+  auto t = std::chrono::steady_clock::now();
+  for(int i=0; i<frames; i++) {
+    View = spin(2 * M_PI / frames) * View;
+    take("");
+    }
+  ld elapsed = ms_since(t);
+  fclose(f);
+  set_shotx();
+  println(hlog, frames, " frames at ", shotx, "x", shoty, (vid.usingGL ? " (OpenGL)" : " (software)"), " in ", int(elapsed), " ms: ",
+    frames * 1000. / max<ld>(elapsed, 1), " frames/s; started in ", int(started), " ms");
+  }
 #endif
 
 EX void take(string fname, const function<void()>& what IS(default_screenshot_content)) {
@@ -799,7 +1077,10 @@ EX void take(string fname, const function<void()>& what IS(default_screenshot_co
     case screenshot_format::png:
     case screenshot_format::rawfile:
       #if CAP_PNG
-      render_png(fname, what);
+      if(tile_size > 0 && (shotx > tile_size || shoty > tile_size))
+        render_png_tiled(fname, what);
+      else
+        render_png(fname, what);
       #endif
       return;
     }
@@ -850,6 +1131,20 @@ int png_read_args() {
   else if(argis("-shotaa")) {
     shift(); shot_aa = argi();
     }
+  else if(argis("-shottile")) {
+    shift(); tile_size = argi();
+    }
+  #if CAP_PNG
+  else if(argis("-shot-bench")) {
+    PHASE(3); shift(); start_game();
+    benchmark(argi());
+    }
+  #endif
+  #if CAP_PNG && !ISWINDOWS
+  else if(argis("-shot-stdout")) {
+    /* already done in initializeCLI */
+    }
+  #endif
   #if CAP_WRL
   else if(argis("-modelshot")) {
     PHASE(3); shift(); start_game();
@@ -930,6 +1225,7 @@ EX void menu() {
       using namespace svg;
       dialog::addSelItem(XLAT("precision"), "1/"+its(divby), 'p');
       dialog::add_action([] { divby *= 10; if(divby > 1000000) divby = 1; });
+      dialog::addBoolItem_action(XLAT("reuse shapes"), reuse_shapes, 'u');
       #endif
       
       if(models::is_3d(vpconf) || rug::rugged) {
@@ -958,6 +1254,12 @@ EX void menu() {
       #if CAP_PNG
       dialog::addSelItem(XLAT("supersampling"), its(shot_aa), 's');
       dialog::add_action([] { shot_aa *= 2; if(shot_aa > 16) shot_aa = 1; });
+      dialog::addSelItem(XLAT("tile size"), tile_size > 0 ? its(tile_size) : ONOFF(false), 'T');
+      dialog::add_action([] { 
+        dialog::editNumber(tile_size, 0, 8192, 256, 2048, XLAT("tile size"), 
+          XLAT("Large screenshots are rendered in tiles of this size and written row by row, so the memory used does not depend on the image size. 0 = no tiling.")
+          );
+        });
       #endif
       break;
       }
@@ -1121,6 +1423,9 @@ struct animated_parameter {
   ld last;
   string formula;
   reaction_t reaction;
+  /** formula, compiled once; invalid if it does not parse */
+  exp_program prog;
+  bool valid;
   };
 
 vector<animated_parameter> aps;
@@ -1139,7 +1444,14 @@ EX void get_parameter_animation(ld &x, string &s) {
 
 EX void animate_parameter(ld &x, string f, const reaction_t& r) {
   deanimate(x);
-  aps.emplace_back(animated_parameter{&x, x, f, r});
+  aps.emplace_back(animated_parameter{&x, x, f, r, exp_program(), true});
+  auto& ap = aps.back();
+  try {
+    ap.prog.compile(f, {});
+    }
+  catch(hr_parse_exception&) {
+    ap.valid = false;
+    }
   }
 
 int ap_changes;
@@ -1147,9 +1459,9 @@ int ap_changes;
 void apply_animated_parameters() {
   ap_changes = 0;
   for(auto &ap: aps) {
-    if(*ap.value != ap.last) continue;
+    if(*ap.value != ap.last || !ap.valid) continue;
     try {
-      *ap.value = parseld(ap.formula);
+      *ap.value = real(ap.prog.eval());
       }
     catch(hr_parse_exception&) {
       continue;
@@ -109,6 +109,14 @@
 #define CAP_FILES (!ISMINI)
 #endif
 
+#ifndef CAP_MMAP
+#define CAP_MMAP (CAP_FILES && !ISWINDOWS && !ISWEB)
+#endif
+
+#ifndef CAP_DISKCACHE
+#define CAP_DISKCACHE (CAP_FILES && !ISWEB && !ISMOBILE)
+#endif
+
 #ifndef CAP_INV
 #define CAP_INV (!ISMINI)
 #endif
@@ -476,8 +484,13 @@ typedef unsigned GLuint;
 #include <mutex>
 #include <condition_variable>
 #endif
+#include <atomic>
+#elif CAP_PROFILING
+#include <atomic>
 #endif
 
+#include <chrono>
+
 #ifdef USE_UNORDERED_MAP
 #include <unordered_map>
 #include <unordered_set>
@@ -494,12 +507,12 @@ typedef unsigned GLuint;
 #include <dirent.h>
 #endif
 
-#if CAP_TEXTURE
-#if CAP_SDL_IMG
+#if CAP_TEXTURE && CAP_SDL_IMG
 #include <SDL/SDL_image.h>
-#elif CAP_PNG
-#include <png.h>
 #endif
+
+#if CAP_PNG
+#include <png.h>
 #endif
 
 #if CAP_FILES
@@ -508,6 +521,11 @@ typedef unsigned GLuint;
 #include <sys/stat.h>
 #endif
 
+#if CAP_MMAP
+#include <sys/mman.h>
+#include <fcntl.h>
+#endif
+
 #if CAP_TIMEOFDAY
 #include <sys/time.h>
 #endif
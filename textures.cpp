@@ -26,6 +26,13 @@ struct textureinfo : basic_textureinfo {
   // these are required to adjust to geometry changes
   int current_type, symmetries;
   };
+
+/** the vertices computed by true_remap for the given triangles (which determine them) */
+struct remap_cache_entry {
+  vector<array<hyperpoint, 3>> v;
+  int splits;
+  vector<glvertex> vertices;
+  };
 #endif
 
 EX namespace texture {
@@ -86,6 +93,11 @@ struct texture_config {
   
   map<int, textureinfo> texture_map, texture_map_orig;
   set<cell*> models;
+
+  /** true_remap results, indexed by the geometry (cgi_string and the pattern) and the pattern id */
+  map<pair<string, int>, remap_cache_entry> remap_cache;
+  /** statistics of the last true_remap */
+  int remap_ticks, remap_computed, remap_reused;
   
   basic_textureinfo tinf3;
 
@@ -127,6 +139,7 @@ struct texture_config {
     color_alpha = 128;
     gsplits = 1;
     texture_tuned = false;
+    remap_ticks = remap_computed = remap_reused = 0;
     }
   
   };
@@ -1391,6 +1404,7 @@ EX void showMenu() {
           return config.save();
           });
       });
+    dialog::addInfo(XLAT("last remap: %1 ms (%2 tiles computed, %3 reused)", its(config.remap_ticks), its(config.remap_computed), its(config.remap_reused)));
     }
   
   dialog::addSelItem(XLAT("precision"), its(config.gsplits), 'P');
@@ -1590,12 +1604,53 @@ EX void drawLine(shiftpoint h1, shiftpoint h2, color_t col, int steps IS(10)) {
     drawPixel(h2, col);
   }
 
+/** the vertices which mapTextureTriangle would produce, without computing the texture coordinates */
+void splitTriangle(vector<glvertex>& vertices, const array<hyperpoint, 3>& v, int splits) {
+  if(splits) {
+    array<hyperpoint, 3> v2 = make_array( mid(v[1], v[2]), mid(v[2], v[0]), mid(v[0], v[1]) );
+    splitTriangle(vertices, make_array(v[0], v2[2], v2[1]), splits-1);
+    splitTriangle(vertices, make_array(v[1], v2[0], v2[2]), splits-1);
+    splitTriangle(vertices, make_array(v[2], v2[1], v2[0]), splits-1);
+    splitTriangle(vertices, make_array(v2[0], v2[1], v2[2]), splits-1);
+    return;
+    }
+  for(int i=0; i<3; i++) vertices.push_back(glhr::pointtogl(v[i]));
+  }
+
+/** remap the texture to the current geometry
+ *
+ *  The cells are first assigned to pattern ids serially. Then each new id is mapped on the worker threads:
+ *  its texture vertices are copied from the original mapping, so only the vertices need to be computed, and
+ *  these are reused from remap_cache if the triangles have not changed.
+ */
 void texture_config::true_remap() {
   models::configure();
   drawthemap();
   if(GDIM == 3) return;
+  int t0 = SDL_GetTicks();
   texture_map.clear();
   missing_cells_known.clear();
+  string geometry_key = cgi_string() + "PAT: " + its(patterns::whichPattern) + "," + its(patterns::subpattern_flags);
+
+  struct remap_job {
+    textureinfo *mi;
+    const textureinfo *orig;
+    remap_cache_entry *entry;
+    bool reuse;
+    };
+  vector<remap_job> jobs;
+  /** the index in jobs for each pattern id; the jobs share texture_map and remap_cache entries, so there must be one per id */
+  map<int, int> job_of;
+
+  auto same_triangles = [] (const remap_cache_entry& e, const textureinfo& mi) {
+    if(isize(e.v) != isize(mi.triangles)) return false;
+    for(int i=0; i<isize(e.v); i++)
+      for(int j=0; j<3; j++)
+        for(int k=0; k<MAXMDIM; k++)
+          if(e.v[i][j][k] != mi.triangles[i].v[j][k]) return false;
+    return true;
+    };
+
   for(cell *c: dcal) {
     auto si = patterns::getpatterninfo0(c);
     int oldid = patterns::getpatterninfo(c, patterns::whichPattern, patterns::subpattern_flags | patterns::SPF_NO_SUBCODES).id;
@@ -1609,35 +1664,65 @@ void texture_config::true_remap() {
       oldid = !si.id;
       }
 
-    try {
-
-      auto& mi = texture_map_orig.at(oldid);  
-      int ncurr = isize(mi.tvertices);  
-      int ntarget = ncurr * celltriangles(c) / mi.current_type;
-      vector<glvertex> new_tvertices = mi.tvertices;
-      new_tvertices.resize(ntarget);
-      for(int i=ncurr; i<ntarget; i++) {
-        new_tvertices[i] = new_tvertices[i - ncurr];
-        }
-      
-      auto& mi2 = texture_map[si.id];
-      mi2 = mi;
-      if(GOLDBERG || IRREGULAR) pshift += si.dir;
-      mapTexture(c, mi2, si, ggmatrix(c), pshift);
-      mapTexture2(mi2);
-      mi2.tvertices = move(new_tvertices);
-      // printf("%08x remapping %d vertices to %d vertices\n", si.id, isize(mi.tvertices), isize(mi2.tvertices));
-      }
-    catch(out_of_range&) { 
+    if(!texture_map_orig.count(oldid)) {
       if(missing_cells_known.count(si.id) == 0) {
         missing_cells_known.insert(si.id);
         printf("Unexpected missing cell #%d/%d\n", si.id, oldid);
         addMessage(XLAT("Unexpected missing cell #%1/%1", its(si.id), its(oldid)));
         }
       // config.tstate_max = config.tstate = tsAdjusting;
-      return;
+      break;
+      }
+
+    auto& mi = texture_map_orig.at(oldid);
+    auto& mi2 = texture_map[si.id];
+    mi2.texture_id = mi.texture_id;
+    mi2.matrices = mi.matrices;
+    if(GOLDBERG || IRREGULAR) pshift += si.dir;
+    mapTexture(c, mi2, si, ggmatrix(c), pshift);
+
+    auto& e = remap_cache[make_pair(geometry_key, si.id)];
+    bool reuse = e.splits == gsplits && same_triangles(e, mi2);
+    if(!reuse) {
+      e.splits = gsplits;
+      e.v.clear();
+      for(auto& t: mi2.triangles) e.v.push_back(t.v);
+      }
+    remap_job job{&mi2, &mi, &e, reuse};
+    if(job_of.count(si.id)) {
+      /* the last cell wins; the vertices need to be computed if any of the cells changed the entry */
+      auto& old = jobs[job_of[si.id]];
+      job.reuse = job.reuse && old.reuse;
+      old = job;
+      }
+    else {
+      job_of[si.id] = isize(jobs);
+      jobs.push_back(job);
       }
     }
+
+  remap_computed = remap_reused = 0;
+  for(auto& j: jobs) (j.reuse ? remap_reused : remap_computed)++;
+
+  workers::parallel_for(0, isize(jobs), 1, [&] (int a, int b) {
+    for(int k=a; k<b; k++) {
+      auto& j = jobs[k];
+      auto& mi2 = *j.mi;
+      auto& mi = *j.orig;
+      if(!j.reuse) {
+        j.entry->vertices.clear();
+        for(auto& t: mi2.triangles) splitTriangle(j.entry->vertices, t.v, gsplits);
+        }
+      mi2.vertices = j.entry->vertices;
+      int ncurr = isize(mi.tvertices);
+      int ntarget = ncurr * mi2.current_type / mi.current_type;
+      mi2.tvertices.resize(ntarget);
+      for(int i=0; i<ntarget; i++)
+        mi2.tvertices[i] = mi.tvertices[i % ncurr];
+      }
+    });
+
+  remap_ticks = SDL_GetTicks() - t0;
   }
 
 void texture_config::remap() {
@@ -74,40 +74,176 @@ EX ld ilerp(ld a0, ld a1, ld x) {
 
 // debug utilities
 
+/** \brief a low-overhead profiler recording scoped zones
+ *
+ *  Every thread writes the zones it completes into its own ring buffer, which
+ *  only that thread writes and only the main thread reads, so recording needs
+ *  no locks. The main thread drains the rings once per frame (profile_frame),
+ *  keeping the events for the Chrome trace (-profile-json) and the per-frame
+ *  totals for the overlay (shift+F6). Recursive zones are recorded only at the
+ *  outermost level. With CAP_PROFILING=0, PROFILE_ZONE compiles to nothing.
+ */
+EX namespace profiler {
+
 #if CAP_PROFILING
 
-#define FRAMES 64
-#define CATS 16
+  /** are zones being recorded */
+  EX bool on;
+  /** is the overlay shown */
+  EX bool overlay;
+  /** the Chrome trace is saved to this file on exit, if nonempty */
+  EX string json_filename;
+  /** at most this many events are kept for the Chrome trace; the later ones are dropped */
+  EX int max_events = 1 << 22;
+
+  EX int dropped;
+
+  struct event { const char *name; long long start, stop; };
+
+  enum { RING = 1 << 16, FRAMES = 64 };
+
+  struct ring {
+    event events[RING];
+    std::atomic<unsigned> head, tail;
+    std::atomic<int> overflows;
+    int tid;
+    ring *next;
+    ring() : head(0), tail(0), overflows(0) {}
+    };
+
+  /** all the rings, never freed, since the worker threads live until the end */
+  std::atomic<ring*> rings;
+  std::atomic<int> ring_count;
+  thread_local ring *my_ring;
+
+  ring& get_ring() {
+    if(!my_ring) {
+      my_ring = new ring;
+      my_ring->tid = ring_count++;
+      my_ring->next = rings.load();
+      while(!rings.compare_exchange_weak(my_ring->next, my_ring)) ;
+      }
+    return *my_ring;
+    }
 
-long long proftable[16][FRAMES];
-int pframeid;
+  EX long long now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
 
-void profile_frame() { 
-  pframeid++; pframeid %=  FRAMES;
-  for(int t=0; t<16; t++) proftable[t][pframeid] = 0;
-  }
+  long long start_time = now();
 
-EX void profile_start(int t) { proftable[t][pframeid] -= getms(); }
-EX void profile_stop(int t) { proftable[t][pframeid] += getms(); }
+  EX void record(const char *name, long long start) {
+    ring& r = get_ring();
+    unsigned h = r.head.load(std::memory_order_relaxed);
+    if(h - r.tail.load(std::memory_order_acquire) >= RING) { r.overflows++; return; }
+    r.events[h % RING] = event{name, start, now()};
+    r.head.store(h+1, std::memory_order_release);
+    }
 
-void profile_info() {
-  for(int t=0; t<16; t++) {
-    sort(proftable[t], proftable[t]+FRAMES);
-    if(proftable[t][FRAMES-1] == 0) continue;
-    long long sum = 0;
-    for(int f=0; f<FRAMES; f++) sum += proftable[t][f];
-    printf("Category %d: avg = %Ld, %Ld..%Ld..%Ld..%Ld..%Ld\n",
-      t, sum / FRAMES, proftable[t][0], proftable[t][16], proftable[t][32],
-      proftable[t][48], proftable[t][63]);
+  struct trace_event { event e; int tid; };
+  vector<trace_event> trace;
+
+  /** the total time of a zone in each of the last FRAMES frames, in microseconds */
+  struct zone_stats {
+    const char *name;
+    long long total[FRAMES];
+    int calls;
+    };
+  vector<zone_stats> stats;
+  int frame_id;
+
+  zone_stats& stats_for(const char *name) {
+    for(auto& z: stats) if(z.name == name || !strcmp(z.name, name)) return z;
+    stats.emplace_back();
+    auto& z = stats.back();
+    z.name = name;
+    for(auto& t: z.total) t = 0;
+    z.calls = 0;
+    return z;
     }
-  }
+
+  EX void drain() {
+    for(ring *r = rings.load(std::memory_order_acquire); r; r = r->next) {
+      unsigned t = r->tail.load(std::memory_order_relaxed), h = r->head.load(std::memory_order_acquire);
+      for(; t != h; t++) {
+        auto& e = r->events[t % RING];
+        auto& z = stats_for(e.name);
+        z.total[frame_id] += e.stop - e.start;
+        z.calls++;
+        if(json_filename != "") {
+          if(isize(trace) < max_events) trace.push_back(trace_event{e, r->tid});
+          else dropped++;
+          }
+        }
+      r->tail.store(t, std::memory_order_release);
+      dropped += r->overflows.exchange(0);
+      }
+    }
+
+  EX void frame() {
+    if(!on) return;
+    drain();
+    frame_id = (frame_id + 1) % FRAMES;
+    for(auto& z: stats) z.total[frame_id] = 0;
+    }
+
+  EX void save_json(const string& fname) {
+    drain();
+    fhstream f(fname, "wt");
+    if(!f.f) { println(hlog, "failed to write ", fname); return; }
+    println(f, "{\"traceEvents\":[");
+    bool first = true;
+    for(auto& te: trace) {
+      if(!first) println(f, ",");
+      first = false;
+      print(f, format("{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld}", te.e.name, te.tid, te.e.start - start_time, te.e.stop - te.e.start));
+      }
+    println(f, "\n]}");
+    println(hlog, "saved ", isize(trace), " events to ", fname, dropped ? format(" (%d dropped)", dropped) : "");
+    }
+
+  EX void draw_overlay() {
+    drain();
+    int y = vid.fsize * 3;
+    for(auto& z: stats) {
+      long long sum = 0, worst = 0;
+      for(auto t: z.total) sum += t, worst = max(worst, t);
+      if(!worst) continue;
+      displayfr(vid.fsize, y, 1, vid.fsize, format("%-14s %7.2f ms (max %7.2f)", z.name, sum / 1000. / FRAMES, worst / 1000.), 0xFFFFFF, 0);
+      y += vid.fsize;
+      }
+    }
+
+  EX void finish() {
+    if(json_filename != "") save_json(json_filename);
+    }
+
 #endif
 
-#if !CAP_PROFILING
+EX }
+
 #if HDR
+#if CAP_PROFILING
+/** records the time from its construction to its destruction as the zone name; reentry stops nested zones of the same site from being recorded */
+struct profile_zone {
+  const char *name;
+  long long start;
+  bool *reentry;
+  profile_zone(const char *n, bool& r) : name(n), start(-1), reentry(&r) {
+    if(profiler::on && !r) r = true, start = profiler::now();
+    }
+  ~profile_zone() {
+    if(start >= 0) *reentry = false, profiler::record(name, start);
+    }
+  };
+#define PROFILE_CAT2(a,b) a##b
+#define PROFILE_CAT(a,b) PROFILE_CAT2(a,b)
+#define PROFILE_ZONE(name) static thread_local bool PROFILE_CAT(profile_reentry_, __LINE__); profile_zone PROFILE_CAT(profile_zone_, __LINE__)(name, PROFILE_CAT(profile_reentry_, __LINE__))
+#define profile_frame() profiler::frame()
+#define profile_info() profiler::finish()
+#else
+#define PROFILE_ZONE(name)
 #define profile_frame()
-#define profile_start(t)
-#define profile_stop(t)
 #define profile_info()
 #endif
 #endif
@@ -183,6 +319,36 @@ struct exp_parser {
     }
 
   };
+
+/** \brief a formula compiled once into bytecode, for formulas evaluated many times
+ *
+ *  The variables given to compile() are read from slots, which should be set before eval();
+ *  the slots for which uses() is false are never read, so they do not need to be computed.
+ *  Formulas using the geometric functions (edge, regradius, edge_angles, regangle, arcmedge) or test
+ *  are not compiled; eval() then falls back to exp_parser.
+ */
+struct exp_program {
+  struct instr {
+    char op;
+    int arg;
+    cld val;
+    ld *ptr;
+    };
+  string s;
+  vector<string> names;
+  vector<instr> code;
+  vector<cld> slots;
+  vector<bool> used;
+  vector<vector<int>> splines;
+  vector<cld> stack;
+  bool interpreted;
+
+  exp_program() { interpreted = false; }
+  /** throws hr_parse_exception on syntax errors */
+  void compile(const string& formula, const vector<string>& variables);
+  bool uses(int i) const { return used[i]; }
+  cld eval();
+  };
 #endif
 
 void exp_parser::skip_white() {
@@ -436,6 +602,326 @@ cld exp_parser::parse(int prio) {
   return res;
   }
 
+/* the bytecode of exp_program */
+
+enum { eoConst, eoSlot, eoStore, eoParam, eoDyn, eoFun, eoNeg, eoAdd, eoSub, eoMul, eoDiv, eoPow, eoIfp, eoWallif, eoRgb, eoTxp, eoSpline };
+
+/* unary functions, in the order exp_parser::parse tries them */
+static const char *exp_functions[] = {
+  "sin(", "cos(", "sinh(", "cosh(", "asin(", "acos(", "asinh(", "acosh(", "exp(", "sqrt(", "log(",
+  "tan(", "tanh(", "atan(", "atanh(", "abs(", "re(", "im(", "conj(", "floor(", "frac(", "to01(" };
+
+enum { efFloor = 19, efFrac = 20, efTo01 = 21, efCount = 22 };
+
+/* values which change between evaluations */
+enum { edS, edMs, edMousex, edMousey, edMousez, edShot, edRandom, edStep, edUltraMirrorDist, edPslSteps, edSingleStep };
+
+struct exp_unsupported {};
+
+struct exp_compiler : exp_parser {
+  exp_program *prog;
+  /** let variables in scope, innermost last */
+  vector<pair<string, int>> scope;
+  int depth, max_depth;
+
+  void emit(char op, int arg = 0, cld val = 0, ld *ptr = nullptr) {
+    prog->code.push_back(exp_program::instr{op, arg, val, ptr});
+    switch(op) {
+      case eoConst: case eoSlot: case eoParam: case eoDyn: case eoSpline: depth++; break;
+      case eoStore: case eoAdd: case eoSub: case eoMul: case eoDiv: case eoPow: case eoWallif: depth--; break;
+      case eoIfp: case eoRgb: depth -= 2; break;
+      }
+    max_depth = max(max_depth, depth);
+    }
+
+  int new_slot() { prog->slots.emplace_back(0); return isize(prog->slots) - 1; }
+
+  int find_var(const string& name) {
+    for(int i=isize(scope)-1; i>=0; i--) if(scope[i].first == name) return scope[i].second;
+    for(int i=0; i<isize(prog->names); i++) if(prog->names[i] == name) { prog->used[i] = true; return i; }
+    return -1;
+    }
+
+  void compile_par() { compile(0); force_eat(")"); }
+
+  void compile(int prio);
+  };
+
+void exp_compiler::compile(int prio) {
+  skip_white();
+  for(int f=0; f<efCount; f++) if(eat(exp_functions[f])) {
+    compile_par();
+    emit(eoFun, f);
+    if(f == efTo01) return;
+    goto binary;
+    }
+  if(eat("edge(") || eat("edge_angles(") || eat("regradius(") || eat("arcmedge(") || eat("regangle(") || eat("test(")) throw exp_unsupported();
+  else if(eat("ifp(")) {
+    compile(0);
+    force_eat(",");
+    compile(0);
+    force_eat(",");
+    compile_par();
+    emit(eoIfp);
+    }
+  else if(eat("wallif(")) {
+    compile(0);
+    force_eat(",");
+    compile_par();
+    emit(eoWallif, find_var("p"));
+    }
+  else if(eat("rgb(")) {
+    compile(0);
+    force_eat(",");
+    compile(0);
+    force_eat(",");
+    compile_par();
+    emit(eoRgb, find_var("p"));
+    }
+  else if(eat("let(")) {
+    string name = next_token();
+    force_eat("=");
+    compile(0);
+    force_eat(",");
+    int id = new_slot();
+    emit(eoStore, id);
+    scope.emplace_back(name, id);
+    compile_par();
+    scope.pop_back();
+    }
+  #if CAP_TEXTURE
+  else if(eat("txp(")) {
+    compile_par();
+    emit(eoTxp, find_var("p"));
+    }
+  #endif
+  else if(next() == '(') at++, compile_par();
+  else {
+    string number = next_token();
+    int id = find_var(number);
+    if(id >= 0) emit(eoSlot, id);
+    else if(params.count(number)) emit(eoParam, 0, 0, &params.at(number));
+    else if(number == "e") emit(eoConst, 0, exp(1));
+    else if(number == "i") emit(eoConst, 0, cld(0, 1));
+    else if(number == "p" || number == "pi") emit(eoConst, 0, M_PI);
+    else if(number == "" && next() == '-') { at++; compile(prio); emit(eoNeg); }
+    else if(number == "") throw hr_parse_exception("number missing, " + where());
+    else if(number == "s") emit(eoDyn, edS);
+    else if(number == "ms") emit(eoDyn, edMs);
+    else if(number[0] == '0' && number[1] == 'x') emit(eoConst, 0, strtoll(number.c_str()+2, NULL, 16));
+    else if(number == "mousex") emit(eoDyn, edMousex);
+    else if(number == "deg") emit(eoConst, 0, degree);
+    else if(number == "ultra_mirror_dist") emit(eoDyn, edUltraMirrorDist);
+    else if(number == "psl_steps") emit(eoDyn, edPslSteps);
+    else if(number == "single_step") emit(eoDyn, edSingleStep);
+    else if(number == "step") emit(eoDyn, edStep);
+    else if(number == "mousey") emit(eoDyn, edMousey);
+    else if(number == "random") emit(eoDyn, edRandom);
+    else if(number == "mousez") emit(eoDyn, edMousez);
+    else if(number == "shot") emit(eoDyn, edShot);
+    else if(number[0] >= 'a' && number[0] <= 'z') throw hr_parse_exception("unknown value: " + number);
+    else { std::stringstream ss; cld res = 0; ss << number; ss >> res; emit(eoConst, 0, res); }
+    }
+  binary:
+  while(true) {
+    skip_white();
+    #if CAP_ANIMATIONS
+    if(next() == '.' && next(1) == '.' && prio == 0) {
+      static const cld NO_DERIVATIVE(3.1, 2.5);
+      /* each piece of the spline is kept in four slots, as in exp_parser::parse */
+      vector<array<int, 4>> rest;
+      auto add_piece = [&] {
+        array<int, 4> a;
+        for(auto& x: a) x = new_slot();
+        rest.push_back(a);
+        emit(eoStore, a[0]); emit(eoSlot, a[0]); emit(eoStore, a[2]);
+        emit(eoConst, 0, NO_DERIVATIVE); emit(eoStore, a[1]);
+        emit(eoConst, 0, NO_DERIVATIVE); emit(eoStore, a[3]);
+        };
+      add_piece();
+      bool second = true;
+      while(next() == '.' && next(1) == '.') {
+        if(next(2) == '/') {
+          at += 3;
+          compile(10);
+          emit(eoStore, rest.back()[second ? 3 : 1]);
+          continue;
+          }
+        else if(next(2) == '|') {
+          at += 3;
+          compile(10);
+          emit(eoStore, rest.back()[2]);
+          emit(eoConst, 0, NO_DERIVATIVE); emit(eoStore, rest.back()[3]);
+          second = true;
+          continue;
+          }
+        at += 2;
+        compile(10);
+        add_piece();
+        second = false;
+        }
+      vector<int> all;
+      for(auto& a: rest) for(int x: a) all.push_back(x);
+      prog->splines.push_back(all);
+      emit(eoSpline, isize(prog->splines) - 1);
+      return;
+      }
+    else
+    #endif
+    if(next() == '+' && prio <= 10) at++, compile(20), emit(eoAdd);
+    else if(next() == '-' && prio <= 10) at++, compile(20), emit(eoSub);
+    else if(next() == '*' && prio <= 20) at++, compile(30), emit(eoMul);
+    else if(next() == '/' && prio <= 20) at++, compile(30), emit(eoDiv);
+    else if(next() == '^') at++, compile(40), emit(eoPow);
+    else break;
+    }
+  }
+
+void exp_program::compile(const string& formula, const vector<string>& variables) {
+  s = formula;
+  names = variables;
+  code.clear();
+  splines.clear();
+  slots.assign(isize(names), 0);
+  used.assign(isize(names), false);
+  interpreted = false;
+  exp_compiler ec;
+  ec.s = formula;
+  ec.prog = this;
+  ec.depth = ec.max_depth = 0;
+  try {
+    ec.compile(0);
+    }
+  catch(exp_unsupported&) {
+    interpreted = true;
+    code.clear();
+    splines.clear();
+    slots.resize(isize(names));
+    used.assign(isize(names), true);
+    }
+  stack.resize(ec.max_depth);
+  }
+
+static ld exp_validate_real(cld x) {
+  if(kz(imag(x))) throw hr_parse_exception("expected real number but " + lalign(-1, x) + " found");
+  return real(x);
+  }
+
+static cld exp_function(int f, cld x) {
+  switch(f) {
+    case 0: return sin(x);
+    case 1: return cos(x);
+    case 2: return sinh(x);
+    case 3: return cosh(x);
+    case 4: return asin(x);
+    case 5: return acos(x);
+    case 6: return asinh(x);
+    case 7: return acosh(x);
+    case 8: return exp(x);
+    case 9: return sqrt(x);
+    case 10: return log(x);
+    case 11: return tan(x);
+    case 12: return tanh(x);
+    case 13: return atan(x);
+    case 14: return atanh(x);
+    case 15: return abs(x);
+    case 16: return real(x);
+    case 17: return imag(x);
+    case 18: return std::conj(x);
+    case efFloor: return floor(exp_validate_real(x));
+    case efFrac: return x - floor(exp_validate_real(x));
+    case efTo01: return atan(x) / ld(M_PI) + ld(0.5);
+    }
+  return x;
+  }
+
+static cld exp_dynamic(int d) {
+  switch(d) {
+    case edS: return ticks / 1000.;
+    case edMs: return ticks;
+    case edMousex: return mousex;
+    case edMousey: return mousey;
+    case edMousez: return cld(mousex - current_display->xcenter, mousey - current_display->ycenter) / cld(current_display->radius, 0);
+    case edShot: return inHighQual ? 1 : 0;
+    case edRandom: return randd();
+    case edStep: return hdist0(tC0(currentmap->adj(cwt.at, 0)));
+    case edUltraMirrorDist: return cgi.ultra_mirror_dist;
+    case edPslSteps: return cgi.psl_steps;
+    case edSingleStep: return cgi.single_step;
+    }
+  return 0;
+  }
+
+cld exp_program::eval() {
+  if(interpreted) {
+    exp_parser ep;
+    ep.s = s;
+    for(int i=0; i<isize(names); i++) ep.extra_params[names[i]] = slots[i];
+    return ep.parse();
+    }
+  int sp = 0;
+  cld *st = stack.data();
+  for(auto& i: code) switch(i.op) {
+    case eoConst: st[sp++] = i.val; break;
+    case eoSlot: st[sp++] = slots[i.arg]; break;
+    case eoStore: slots[i.arg] = st[--sp]; break;
+    case eoParam: st[sp++] = *i.ptr; break;
+    case eoDyn: st[sp++] = exp_dynamic(i.arg); break;
+    case eoFun: st[sp-1] = exp_function(i.arg, st[sp-1]); break;
+    case eoNeg: st[sp-1] = -st[sp-1]; break;
+    case eoAdd: sp--; st[sp-1] = st[sp-1] + st[sp]; break;
+    case eoSub: sp--; st[sp-1] = st[sp-1] - st[sp]; break;
+    case eoMul: sp--; st[sp-1] = st[sp-1] * st[sp]; break;
+    case eoDiv: sp--; st[sp-1] = st[sp-1] / st[sp]; break;
+    case eoPow: sp--; st[sp-1] = pow(st[sp-1], st[sp]); break;
+    case eoIfp: sp -= 2; st[sp-1] = real(st[sp-1]) > 0 ? st[sp] : st[sp+1]; break;
+    case eoWallif: {
+      sp--;
+      ld p = i.arg >= 0 ? real(slots[i.arg]) : 0;
+      if(p < 3.5) st[sp-1] = st[sp];
+      break;
+      }
+    case eoRgb: {
+      sp -= 2;
+      int p = int((i.arg >= 0 ? real(slots[i.arg]) : 0) + .5);
+      st[sp-1] = p == 1 ? st[sp-1] : p == 2 ? st[sp] : p == 3 ? st[sp+1] : cld(0);
+      break;
+      }
+    #if CAP_TEXTURE
+    case eoTxp: {
+      int p = int((i.arg >= 0 ? real(slots[i.arg]) : 0) + .5);
+      st[sp-1] = texture::get_txp(real(st[sp-1]), imag(st[sp-1]), p-1);
+      break;
+      }
+    #endif
+    #if CAP_ANIMATIONS
+    case eoSpline: {
+      static const cld NO_DERIVATIVE(3.1, 2.5);
+      auto& sl = splines[i.arg];
+      int n = isize(sl) / 4;
+      ld v = ticks * (n-1.) / anims::period;
+      int vf = v;
+      v -= vf;
+      vf %= (n-1);
+      auto lft = [&] (int k) { return slots[sl[4*vf+k]]; };
+      auto rgt = [&] (int k) { return slots[sl[4*vf+4+k]]; };
+      cld res;
+      if(lft(3) == NO_DERIVATIVE && rgt(1) == NO_DERIVATIVE)
+        res = lerp(lft(2), rgt(0), v);
+      else if(rgt(1) == NO_DERIVATIVE)
+        res = lerp(lft(2) + lft(3) * v, rgt(0), v*v);
+      else if(lft(3) == NO_DERIVATIVE)
+        res = lerp(lft(2), rgt(0) + rgt(1) * (v-1), (2-v)*v);
+      else
+        res = lerp(lft(2) + lft(3) * v, rgt(0) + rgt(1) * (v-1), v*v*(3-2*v));
+      st[sp++] = res;
+      break;
+      }
+    #endif
+    }
+  return st[0];
+  }
+
 EX ld parseld(const string& s) {
   exp_parser ep;
   ep.s = s;
@@ -689,33 +1175,471 @@ EX string compress_string(string s) {
   println(hlog, "init ok");
   strm.avail_in = isize(s);
   strm.next_in = (Bytef*) &s[0];
-  vector<char> buf(1000000, 0);
-  strm.avail_out = 1000000;
-  strm.next_out = (Bytef*) &buf[0];
-  if(deflate(&strm, Z_FINISH) != Z_STREAM_END) throw "z-error-2";
+  string out;
+  out.resize(deflateBound(&strm, isize(s)));
+  strm.avail_out = isize(out);
+  strm.next_out = (Bytef*) &out[0];
+  ret = deflate(&strm, Z_FINISH);
+  deflateEnd(&strm);
+  if(ret != Z_STREAM_END) throw "z-error-2";
   println(hlog, "deflate ok");
-  string out(&buf[0], (char*)(strm.next_out) - &buf[0]);
+  out.resize(strm.total_out);
   println(hlog, isize(s), " -> ", isize(out));
   return out;
   }
 
-EX string decompress_string(string s) {
+/** decompress s; the output buffer grows as needed, so there is no limit on the decompressed size */
+EX string decompress_string(const string& s) {
+  string out;
+  decompress_stream(s.data(), isize(s), [&] (const char *data, int len) { out.append(data, len); });
+  println(hlog, isize(s), " -> ", isize(out));
+  return out;
+  }
+
+/** decompress len bytes from data, passing the output to f in chunks */
+EX void decompress_stream(const char *data, size_t len, const function<void(const char*, int)>& f) {
   z_stream strm;
   strm.zalloc = Z_NULL;
   strm.zfree = Z_NULL;
   strm.opaque = Z_NULL;
+  strm.avail_in = 0;
+  strm.next_in = Z_NULL;
   auto ret = inflateInit(&strm);
   if(ret != Z_OK) throw "z-error";
-  strm.avail_in = isize(s);
-  strm.next_in = (Bytef*) &s[0];
-  vector<char> buf(1000000, 0);
-  strm.avail_out = 1000000;
-  strm.next_out = (Bytef*) &buf[0];
-  if(inflate(&strm, Z_FINISH) != Z_STREAM_END) throw "z-error-2";
-  string out(&buf[0], (char*)(strm.next_out) - &buf[0]);
-  println(hlog, isize(s), " -> ", isize(out));
-  return out;
+  const int chunk = 1<<16;
+  vector<char> buf(chunk);
+  /* avail_in is an uInt, so feed huge inputs in pieces */
+  while(true) {
+    if(strm.avail_in == 0 && len) {
+      uInt q = uInt(min<size_t>(len, 1u<<30));
+      strm.next_in = (Bytef*) data;
+      strm.avail_in = q;
+      data += q; len -= q;
+      }
+    strm.avail_out = chunk;
+    strm.next_out = (Bytef*) &buf[0];
+    ret = inflate(&strm, Z_NO_FLUSH);
+    if(ret != Z_OK && ret != Z_STREAM_END) { inflateEnd(&strm); throw "z-error-2"; }
+    f(&buf[0], chunk - strm.avail_out);
+    if(ret == Z_STREAM_END) break;
+    if(strm.avail_in == 0 && !len && strm.avail_out) { inflateEnd(&strm); throw "z-error-2"; }
+    }
+  inflateEnd(&strm);
+  }
+#endif
+
+/** \brief a work-stealing pool of worker threads shared by the heavy computations
+ *
+ *  Every worker has its own queue of tasks, and idle workers steal from the
+ *  queues of the others. A thread waiting for a task_group runs the queued tasks
+ *  meanwhile, so parallel_for can be nested. The threads are started on the first
+ *  use and are reused afterwards.
+ */
+EX namespace workers {
+
+  /** the wanted number of threads, including the calling thread; 0 = one per core */
+  EX int threads_wanted = 0;
+
+#if HDR
+  /** a set of tasks which can be waited for together; the destructor waits too */
+  struct task_group {
+    #if CAP_THREAD
+    int pending;
+    std::mutex lock;
+    std::condition_variable cv;
+    #endif
+    /** the first exception thrown by a task, rethrown by wait */
+    std::exception_ptr error;
+    task_group();
+    ~task_group();
+    /** run f on the pool; background tasks are never picked up by waiting threads, use them for long jobs */
+    void run(const function<void()>& f, bool background = false);
+    /** wait for all the tasks, and rethrow the first exception thrown by them */
+    void wait();
+    /** wait for all the tasks, without rethrowing */
+    void join();
+    bool done();
+    void finish(std::exception_ptr e = nullptr);
+    };
+#endif
+
+  #if CAP_THREAD
+  struct task {
+    function<void()> f;
+    task_group *g;
+    };
+
+  struct task_queue {
+    std::mutex lock;
+    std::deque<task> q;
+
+    void push(task&& t) { std::lock_guard<std::mutex> lk(lock); q.push_back(std::move(t)); }
+    bool pop_back(task& t) {
+      std::lock_guard<std::mutex> lk(lock);
+      if(q.empty()) return false;
+      t = std::move(q.back()); q.pop_back();
+      return true;
+      }
+    bool pop_front(task& t) {
+      std::lock_guard<std::mutex> lk(lock);
+      if(q.empty()) return false;
+      t = std::move(q.front()); q.pop_front();
+      return true;
+      }
+    };
+
+  enum { MAX_WORKERS = 256 };
+
+  /** the index of the queue of the current thread; -1 if it is not a worker */
+  thread_local int my_queue = -1;
+
+  struct pool {
+    vector<std::thread> threads;
+    /** queues[MAX_WORKERS] is used by the threads which are not workers */
+    vector<task_queue> queues;
+    task_queue background;
+    std::mutex lock, start_lock;
+    std::condition_variable wake;
+    std::atomic<int> workers, queued, bg_queued;
+    bool quit;
+
+    pool() : queues(MAX_WORKERS + 1), workers(0), queued(0), bg_queued(0), quit(false) {}
+
+    task_queue& own() { return queues[my_queue >= 0 ? my_queue : int(MAX_WORKERS)]; }
+
+    bool try_run(bool with_background) {
+      task t;
+      bool found = false;
+      if(my_queue >= 0) found = queues[my_queue].pop_back(t);
+      int n = workers;
+      for(int i=0; i<=n && !found; i++) {
+        int k = (my_queue + 1 + i) % (n + 1);
+        found = queues[k == n ? int(MAX_WORKERS) : k].pop_front(t);
+        }
+      if(found) queued--;
+      else if(with_background && background.pop_front(t)) found = true, bg_queued--;
+      if(!found) return false;
+      try { t.f(); }
+      catch(...) { t.g->finish(std::current_exception()); return true; }
+      t.g->finish();
+      return true;
+      }
+
+    void worker(int id) {
+      my_queue = id;
+      while(true) {
+        if(try_run(true)) continue;
+        std::unique_lock<std::mutex> lk(lock);
+        wake.wait(lk, [this] { return quit || queued > 0 || bg_queued > 0; });
+        if(quit) return;
+        }
+      }
+
+    void start(int q) {
+      q = min<int>(q, MAX_WORKERS);
+      if(workers >= q) return;
+      std::lock_guard<std::mutex> lk(start_lock);
+      while(workers < q) {
+        int id = workers;
+        threads.emplace_back([this, id] { worker(id); });
+        workers++;
+        }
+      }
+
+    void notify(std::atomic<int>& counter) {
+      { std::lock_guard<std::mutex> lk(lock); counter++; }
+      wake.notify_one();
+      }
+
+    void stop() {
+      std::lock_guard<std::mutex> sl(start_lock);
+      { std::lock_guard<std::mutex> lk(lock); quit = true; }
+      wake.notify_all();
+      for(auto& t: threads) t.join();
+      threads.clear();
+      workers = 0;
+      quit = false;
+      }
+    };
+
+  /* never destroyed, so that the threads do not need to be joined at exit */
+  pool& the_pool() { static pool *p = new pool; return *p; }
+
+  task_group::task_group() : pending(0) {}
+
+  void task_group::run(const function<void()>& f, bool background) {
+    auto& p = the_pool();
+    /* background tasks need a worker even if no parallelism is wanted */
+    p.start(max(get_threads() - 1, 1));
+    { std::lock_guard<std::mutex> lk(lock); pending++; }
+    if(background) {
+      p.background.push(task{f, this});
+      p.notify(p.bg_queued);
+      }
+    else {
+      p.own().push(task{f, this});
+      p.notify(p.queued);
+      }
+    }
+
+  void task_group::finish(std::exception_ptr e) {
+    std::lock_guard<std::mutex> lk(lock);
+    if(e && !error) error = e;
+    if(!--pending) cv.notify_all();
+    }
+
+  bool task_group::done() {
+    std::lock_guard<std::mutex> lk(lock);
+    return !pending;
+    }
+
+  void task_group::join() {
+    while(!done()) {
+      if(the_pool().try_run(false)) continue;
+      std::unique_lock<std::mutex> lk(lock);
+      cv.wait_for(lk, std::chrono::milliseconds(1), [this] { return !pending; });
+      }
+    }
+  #else
+  task_group::task_group() {}
+  void task_group::run(const function<void()>& f, bool background) {
+    try { f(); }
+    catch(...) { finish(std::current_exception()); }
+    }
+  void task_group::finish(std::exception_ptr e) { if(e && !error) error = e; }
+  bool task_group::done() { return true; }
+  void task_group::join() {}
+  #endif
+
+  void task_group::wait() {
+    join();
+    if(error) {
+      auto e = error;
+      error = nullptr;
+      std::rethrow_exception(e);
+      }
+    }
+
+  task_group::~task_group() { join(); }
+
+  /** the number of threads parallel_for will use */
+  EX int get_threads() {
+    #if CAP_THREAD
+    if(threads_wanted > 0) return min<int>(threads_wanted, MAX_WORKERS + 1);
+    return max<int>(std::thread::hardware_concurrency(), 1);
+    #else
+    return 1;
+    #endif
+    }
+
+  /** call f(a, b) for subranges [a, b) covering [from, to), of at most grain elements each; the ranges may be processed in parallel */
+  EX void parallel_for(int from, int to, int grain, const function<void(int, int)>& f) {
+    if(from >= to) return;
+    if(grain < 1) grain = 1;
+    #if CAP_THREAD
+    int chunks = (to - from + grain - 1) / grain;
+    int q = min(get_threads(), chunks);
+    if(q > 1) {
+      std::atomic<int> next(from);
+      auto work = [&] {
+        while(true) {
+          int a = next.fetch_add(grain);
+          if(a >= to) return;
+          f(a, min(a + grain, to));
+          }
+        };
+      task_group g;
+      for(int i=1; i<q; i++) g.run(work);
+      work();
+      g.wait();
+      return;
+      }
+    #endif
+    for(int a=from; a<to; a+=grain) f(a, min(a + grain, to));
+    }
+
+#if HDR
+  /** reduce f(a, b) over the subranges of [from, to) with combine; the subranges depend only on grain, and the
+   *  partial results are combined in order, so the result does not depend on the number of threads */
+  template<class T, class F, class C> T parallel_reduce(int from, int to, int grain, T init, const F& f, const C& combine) {
+    if(from >= to) return init;
+    if(grain < 1) grain = 1;
+    int chunks = (to - from + grain - 1) / grain;
+    vector<T> partial(chunks, init);
+    parallel_for(0, chunks, 1, [&] (int a, int b) {
+      for(int k=a; k<b; k++) partial[k] = f(from + k * grain, min(from + (k+1) * grain, to));
+      });
+    for(auto& p: partial) init = combine(init, p);
+    return init;
+    }
+#endif
+
+  #if CAP_THREAD
+  auto hook = addHook(hooks_final_cleanup, 1000, [] { the_pool().stop(); });
+  #endif
+EX }
+
+/** \brief a persistent cache of expensive precomputations
+ *
+ *  Each entry is a file in a versioned cache directory, named after a hash of its kind and key.
+ *  The file repeats the full key, so hash collisions and stale entries are simply treated as misses.
+ */
+EX namespace disk_cache {
+
+  /** bump this when the format of any cached structure changes */
+  const int cache_version = 1;
+
+  EX bool enabled = true;
+
+  /** the cache directory; empty = $HOME/.hyperrogue/cache */
+  EX string dir;
+
+  EX int hits, misses, stores;
+
+  EX string get_dir() {
+    string d = dir;
+    if(d == "") {
+      if(getenv("HOME")) d = getenv("HOME"), d += "/";
+      d += ".hyperrogue/cache";
+      }
+    return d + "/v" + its(cache_version);
+    }
+
+  unsigned key_hash(const string& s) {
+    unsigned h = 2166136261u;
+    for(char c: s) h = (h ^ (unsigned char) c) * 16777619u;
+    return h;
+    }
+
+  EX string path_for(const string& kind, const string& key) {
+    return get_dir() + "/" + kind + "-" + itsh8(key_hash(key)) + ".bin";
+    }
+
+  #if CAP_DISKCACHE
+  void make_dir(const string& d) {
+    for(int i=1; i<=isize(d); i++) if(i == isize(d) || d[i] == '/') {
+      string sub = d.substr(0, i);
+      #if ISWINDOWS
+      mkdir(sub.c_str());
+      #else
+      mkdir(sub.c_str(), 0755);
+      #endif
+      }
+    }
+  #endif
+
+  /** read the entry for (kind, key) with reader; returns false (and counts a miss) if there is no valid entry */
+  EX bool load(const string& kind, const string& key, const function<void(hstream&)>& reader) {
+    #if CAP_DISKCACHE
+    if(enabled) {
+      string fname = path_for(kind, key);
+      fhstream f(fname, "rb");
+      if(f.f) try {
+        string k;
+        hread(f, k);
+        if(k == kind + ":" + key) {
+          reader(f);
+          hits++;
+          DEBB(DF_INIT, ("cache hit: ", kind, " from ", fname));
+          return true;
+          }
+        }
+      catch(hstream_exception&) {
+        DEBB(DF_WARN, ("cache entry damaged: ", fname));
+        }
+      }
+    #endif
+    misses++;
+    DEBB(DF_INIT, ("cache miss: ", kind));
+    return false;
+    }
+
+  /** store the entry for (kind, key); the file is written under a temporary name and renamed, so readers never see partial entries */
+  EX void save(const string& kind, const string& key, const function<void(hstream&)>& writer) {
+    #if CAP_DISKCACHE
+    if(!enabled) return;
+    string fname = path_for(kind, key);
+    make_dir(get_dir());
+    string tmp = fname + ".tmp";
+    try {
+      fhstream f(tmp, "wb");
+      if(!f.f) { DEBB(DF_WARN, ("cannot write the cache entry ", tmp)); return; }
+      hwrite(f, kind + ":" + key);
+      writer(f);
+      }
+    catch(hstream_exception&) {
+      DEBB(DF_WARN, ("cannot write the cache entry ", tmp));
+      remove(tmp.c_str());
+      return;
+      }
+    remove(fname.c_str());
+    if(rename(tmp.c_str(), fname.c_str()) == 0) stores++;
+    #endif
+    }
+
+  EX void report() {
+    println(hlog, "disk cache ", get_dir(), ": ", hits, " hits, ", misses, " misses, ", stores, " stored");
+    }
+EX }
+
+#if CAP_COMMANDLINE
+/** compare exp_parser and exp_program on formula, with variables x and y running over a grid */
+void exp_benchmark(const string& formula) {
+  vector<cld> res[2];
+  int times[2];
+  const int N = 100;
+  for(int compiled=0; compiled<2; compiled++) {
+    int t0 = SDL_GetTicks();
+    exp_program prog;
+    if(compiled) prog.compile(formula, {"x", "y"});
+    for(int i=0; i<N; i++) for(int j=0; j<N; j++) {
+      ld x = i * 2. / N - 1, y = j * 2. / N - 1;
+      if(compiled) {
+        if(prog.uses(0)) prog.slots[0] = x;
+        if(prog.uses(1)) prog.slots[1] = y;
+        res[1].push_back(prog.eval());
+        }
+      else {
+        exp_parser ep;
+        ep.extra_params["x"] = x;
+        ep.extra_params["y"] = y;
+        ep.s = formula;
+        res[0].push_back(ep.parse());
+        }
+      }
+    times[compiled] = SDL_GetTicks() - t0;
+    if(compiled) println(hlog, "compiled: ", isize(prog.code), " instructions", prog.interpreted ? " (interpreted)" : "");
+    }
+  int diff = 0;
+  for(int i=0; i<N*N; i++) if(res[0][i] != res[1][i] && !(res[0][i] != res[0][i])) diff++;
+  println(hlog, "parsed: ", times[0] * 1000. / (N*N), " us, compiled: ", times[1] * 1000. / (N*N), " us per evaluation, ", diff, " differences");
   }
+
+int util_args() {
+  using namespace arg;
+  if(0) ;
+  /* e.g. -exp-bench "sin(x*pi)*let(r=x*x+y*y,exp(-r))" */
+  else if(argis("-exp-bench")) {
+    shift(); exp_benchmark(args());
+    }
+  #if CAP_PROFILING
+  else if(argis("-profile")) {
+    profiler::on = true;
+    }
+  else if(argis("-profile-overlay")) {
+    profiler::on = profiler::overlay = true;
+    }
+  /* the trace is saved on exit, and can be viewed in chrome://tracing or Perfetto */
+  else if(argis("-profile-json")) {
+    shift(); profiler::json_filename = args();
+    profiler::on = true;
+    }
+  #endif
+  else return 1;
+  return 0;
+  }
+
+auto util_hook = addHook(hooks_args, 100, util_args);
 #endif
 
 }